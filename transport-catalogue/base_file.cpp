@@ -0,0 +1,302 @@
+#include "base_file.h"
+#include "parallel.h"
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <system_error>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace BaseFile {
+
+    namespace {
+
+        constexpr char MAGIC[8] = {'T', 'C', 'B', 'A', 'S', 'E', '\0', '\0'};
+        constexpr uint32_t VERSION = 3;
+        constexpr size_t ALIGNMENT = 8;
+        // Последний раздел, известный этому читателю
+        constexpr auto LAST_KNOWN_SECTION = SectionId::MAP_JSON;
+        // Разделы, которые пишутся всегда. Готовые ответы и карта необязательны
+        constexpr SectionId REQUIRED_SECTIONS[] = {
+                SectionId::STRINGS, SectionId::STOPS, SectionId::BUSES, SectionId::BUS_STOPS,
+                SectionId::STOP_VERTICES, SectionId::EDGES, SectionId::INCIDENCE_OFFSETS,
+                SectionId::INCIDENCE_EDGES, SectionId::ROUTER_SETTINGS, SectionId::RENDER_SETTINGS,
+                SectionId::NAME_INDEX_LABELS, SectionId::NAME_INDEX_NODES, SectionId::NAME_INDEX_ENTRIES,
+                SectionId::ROAD_DISTANCES,
+        };
+
+        struct FileHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t section_count;
+            // CRC32C заголовка и таблицы разделов; при подсчёте само поле считается равным 0
+            uint32_t checksum;
+            uint32_t reserved;
+        };
+
+        struct SectionEntry {
+            uint32_t id;
+            // CRC32C содержимого раздела
+            uint32_t checksum;
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        uint32_t HeaderChecksum(FileHeader header, std::string_view table) {
+            header.checksum = 0;
+            std::string bytes(reinterpret_cast<const char *>(&header), sizeof(header));
+            bytes.append(table);
+            return Crc32c(bytes);
+        }
+
+        size_t AlignUp(size_t value) {
+            return (value + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        }
+
+        constexpr uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+        constexpr std::array<uint32_t, 256> MakeCrc32cTable() {
+            std::array<uint32_t, 256> table{};
+            for (uint32_t i = 0; i < table.size(); ++i) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLYNOMIAL : 0);
+                }
+                table[i] = crc;
+            }
+            return table;
+        }
+
+        constexpr std::array<uint32_t, 256> CRC32C_TABLE = MakeCrc32cTable();
+
+        uint32_t Crc32cTable(uint32_t crc, const unsigned char *data, size_t size) {
+            for (size_t i = 0; i < size; ++i) {
+                crc = (crc >> 8) ^ CRC32C_TABLE[(crc ^ data[i]) & 0xFF];
+            }
+            return crc;
+        }
+
+#if defined(__x86_64__) && defined(__GNUC__)
+        // Собирается под SSE4.2 независимо от флагов сборки; вызывается, только если процессор его поддерживает
+        __attribute__((target("sse4.2")))
+        uint32_t Crc32cHardware(uint32_t crc, const unsigned char *data, size_t size) {
+            uint64_t crc64 = crc;
+            for (; size >= sizeof(uint64_t); data += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+                uint64_t word;
+                std::memcpy(&word, data, sizeof(word));
+                crc64 = _mm_crc32_u64(crc64, word);
+            }
+            crc = static_cast<uint32_t>(crc64);
+            for (; size != 0; ++data, --size) {
+                crc = _mm_crc32_u8(crc, *data);
+            }
+            return crc;
+        }
+#endif
+
+    }  // namespace
+
+    MappedFile::MappedFile(const std::string &path) {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "Cannot open base file " + path);
+        }
+        struct stat info{};
+        if (fstat(fd, &info) < 0) {
+            const int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "Cannot open base file " + path);
+        }
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ != 0) {
+            address_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address_ == MAP_FAILED) {
+                const int error = errno;
+                address_ = nullptr;
+                close(fd);
+                throw std::system_error(error, std::generic_category(), "Cannot map base file " + path);
+            }
+        }
+        // Отображение остаётся действительным и после закрытия дескриптора
+        close(fd);
+    }
+
+    MappedFile::MappedFile(MappedFile &&other) noexcept
+            : address_(std::exchange(other.address_, nullptr)),
+              size_(std::exchange(other.size_, 0)) {
+    }
+
+    MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            if (address_) {
+                munmap(address_, size_);
+            }
+            address_ = std::exchange(other.address_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    MappedFile::~MappedFile() {
+        if (address_) {
+            munmap(address_, size_);
+        }
+    }
+
+    std::string_view MappedFile::Data() const {
+        return {static_cast<const char *>(address_), size_};
+    }
+
+    bool IsBaseFile(std::string_view data) {
+        return data.size() >= sizeof(MAGIC) && std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) == 0;
+    }
+
+    uint32_t Crc32c(std::string_view data) {
+        const auto *bytes = reinterpret_cast<const unsigned char *>(data.data());
+#if defined(__x86_64__) && defined(__GNUC__)
+        static const bool hardware = __builtin_cpu_supports("sse4.2");
+        if (hardware) {
+            return ~Crc32cHardware(~0u, bytes, data.size());
+        }
+#endif
+        return ~Crc32cTable(~0u, bytes, data.size());
+    }
+
+    StringRef StringTable::Add(std::string_view text) {
+        if (data_.size() + text.size() > std::numeric_limits<uint32_t>::max()) {
+            throw FormatError("Base file string table overflow");
+        }
+        const StringRef ref{static_cast<uint32_t>(data_.size()), static_cast<uint32_t>(text.size())};
+        data_.append(text);
+        return ref;
+    }
+
+    const std::string &StringTable::GetData() const {
+        return data_;
+    }
+
+    void Writer::AddSection(SectionId id, std::string data) {
+        sections_.emplace_back(id, std::move(data));
+    }
+
+    void Writer::Write(std::ostream &output) const {
+        FileHeader header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.section_count = static_cast<uint32_t>(sections_.size());
+
+        std::vector<SectionEntry> entries(sections_.size());
+        size_t offset = AlignUp(sizeof(FileHeader) + sections_.size() * sizeof(SectionEntry));
+        for (size_t i = 0; i < sections_.size(); ++i) {
+            entries[i] = {static_cast<uint32_t>(sections_[i].first), 0, offset, sections_[i].second.size()};
+            offset = AlignUp(offset + sections_[i].second.size());
+        }
+        Parallel::ForEachRange(sections_.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                entries[i].checksum = Crc32c(sections_[i].second);
+            }
+        });
+        header.checksum = HeaderChecksum(header, {reinterpret_cast<const char *>(entries.data()),
+                                                  entries.size() * sizeof(SectionEntry)});
+
+        static constexpr char PADDING[ALIGNMENT] = {};
+        size_t written = 0;
+        auto write = [&output, &written](const void *data, size_t size) {
+            output.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+            written += size;
+        };
+        write(&header, sizeof(header));
+        write(entries.data(), entries.size() * sizeof(SectionEntry));
+        for (size_t i = 0; i < sections_.size(); ++i) {
+            write(PADDING, entries[i].offset - written);
+            write(sections_[i].second.data(), sections_[i].second.size());
+        }
+    }
+
+    View::View(std::string_view data) {
+        FileHeader header{};
+        if (!IsBaseFile(data) || data.size() < sizeof(header)) {
+            throw FormatError("Not a base file");
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (header.version != VERSION) {
+            throw FormatError("Unsupported base file version " + std::to_string(header.version));
+        }
+        if (header.section_count > (data.size() - sizeof(header)) / sizeof(SectionEntry)) {
+            throw FormatError("Truncated base file");
+        }
+        const std::string_view table = data.substr(sizeof(header), header.section_count * sizeof(SectionEntry));
+        if (HeaderChecksum(header, table) != header.checksum) {
+            throw FormatError("Base file header is corrupted");
+        }
+
+        sections_.reserve(header.section_count);
+        std::vector<uint32_t> checksums;
+        checksums.reserve(header.section_count);
+        for (uint32_t i = 0; i < header.section_count; ++i) {
+            SectionEntry entry{};
+            std::memcpy(&entry, table.data() + i * sizeof(SectionEntry), sizeof(entry));
+            if (entry.offset % ALIGNMENT != 0 || entry.offset > data.size()
+                || entry.size > data.size() - entry.offset) {
+                throw FormatError("Truncated base file");
+            }
+            const auto id = static_cast<SectionId>(entry.id);
+            if (id <= LAST_KNOWN_SECTION && Has(id)) {
+                throw FormatError("Duplicate base file section " + std::to_string(entry.id));
+            }
+            sections_.emplace_back(id, data.substr(entry.offset, entry.size));
+            checksums.push_back(entry.checksum);
+        }
+        for (const SectionId id: REQUIRED_SECTIONS) {
+            if (!Has(id)) {
+                throw FormatError("Base file section " + std::to_string(static_cast<uint32_t>(id)) + " is missing");
+            }
+        }
+        // Неизвестные разделы не проверяются: этот читатель их всё равно не использует
+        Parallel::ForEachRange(sections_.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const auto &[id, bytes] = sections_[i];
+                if (id <= LAST_KNOWN_SECTION && Crc32c(bytes) != checksums[i]) {
+                    throw FormatError("Base file section " + std::to_string(static_cast<uint32_t>(id))
+                                      + " is corrupted");
+                }
+            }
+        });
+        strings_ = Bytes(SectionId::STRINGS);
+    }
+
+    bool View::Has(SectionId id) const {
+        for (const auto &[section_id, bytes]: sections_) {
+            if (section_id == id) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string_view View::Bytes(SectionId id) const {
+        for (const auto &[section_id, bytes]: sections_) {
+            if (section_id == id) {
+                return bytes;
+            }
+        }
+        return {};
+    }
+
+    std::string_view View::String(StringRef ref) const {
+        if (static_cast<uint64_t>(ref.offset) + ref.size > strings_.size()) {
+            throw FormatError("Malformed base file string reference");
+        }
+        return strings_.substr(ref.offset, ref.size);
+    }
+
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Формат базы для отображения в память: заголовок, таблица разделов и выровненные разделы
+// с записями фиксированной ширины. Строки лежат в одном блоке и задаются смещением и длиной.
+// Числа хранятся в порядке байтов little-endian. Заголовок вместе с таблицей разделов и каждый
+// раздел защищены контрольными суммами CRC32C. Версия меняется только при несовместимых изменениях:
+// новые разделы добавляются без её смены, а читатель пропускает разделы, которых не знает
+namespace BaseFile {
+
+    static_assert(std::endian::native == std::endian::little, "Base file layout assumes little-endian");
+
+    class FormatError : public std::runtime_error {
+    public:
+        using runtime_error::runtime_error;
+    };
+
+    enum class SectionId : uint32_t {
+        STRINGS = 1,
+        STOPS,
+        BUSES,
+        BUS_STOPS,
+        STOP_VERTICES,
+        EDGES,
+        INCIDENCE_OFFSETS,
+        INCIDENCE_EDGES,
+        ROUTER_SETTINGS,
+        RENDER_SETTINGS,
+        NAME_INDEX_LABELS,
+        NAME_INDEX_NODES,
+        NAME_INDEX_ENTRIES,
+        ROAD_DISTANCES,
+        RESPONSE_TEXT,
+        STOP_RESPONSES,
+        BUS_RESPONSES,
+        // Готовая карта: строковый литерал JSON с SVG-документом
+        MAP_JSON,
+    };
+
+    struct StringRef {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+    };
+
+    // Остановки и маршруты упорядочены по названию; номер записи служит их идентификатором
+    struct StopRecord {
+        StringRef name;
+        double latitude = 0.0;
+        double longitude = 0.0;
+    };
+
+    struct BusRecord {
+        StringRef name;
+        // Отрезок раздела BUS_STOPS с номерами остановок
+        uint32_t first_stop = 0;
+        uint32_t stop_count = 0;
+        int32_t stops_count = 0;
+        int32_t unique_stops = 0;
+        uint32_t is_loop = 0;
+        uint32_t reserved = 0;
+        double road_length = 0.0;
+        double curvature = 0.0;
+    };
+
+    // owner — номер маршрута для ребра поездки (span > 0) или остановки для ребра ожидания
+    struct EdgeRecord {
+        uint32_t from = 0;
+        uint32_t to = 0;
+        uint32_t span = 0;
+        uint32_t owner = 0;
+        double weight = 0.0;
+    };
+
+    // Расстояние по дороге; записи упорядочены по from, затем по to
+    struct DistanceRecord {
+        uint32_t from = 0;
+        uint32_t to = 0;
+        int32_t distance = 0;
+    };
+
+    // Готовое тело ответа в разделе RESPONSE_TEXT; значение request_id вставляется по смещению split.
+    // Записи STOP_RESPONSES и BUS_RESPONSES идут в порядке номеров остановок и маршрутов
+    struct ResponseRecord {
+        StringRef text;
+        uint32_t split = 0;
+    };
+
+    struct NameIndexEntryRecord {
+        uint32_t is_bus = 0;
+        uint32_t id = 0;
+    };
+
+    // Отображение файла в память только для чтения
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string &path);
+
+        MappedFile(MappedFile &&other) noexcept;
+
+        MappedFile &operator=(MappedFile &&other) noexcept;
+
+        MappedFile(const MappedFile &) = delete;
+
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile();
+
+        [[nodiscard]] std::string_view Data() const;
+
+    private:
+        void *address_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    // Проверяет сигнатуру формата; по ней загрузчик отличает этот формат от protobuf
+    bool IsBaseFile(std::string_view data);
+
+    // CRC32C (полином Кастаньоли); на x86-64 с SSE4.2 считается инструкцией crc32
+    uint32_t Crc32c(std::string_view data);
+
+    // Блок строк: каждая строка добавляется один раз
+    class StringTable {
+    public:
+        StringRef Add(std::string_view text);
+
+        [[nodiscard]] const std::string &GetData() const;
+
+    private:
+        std::string data_;
+    };
+
+    // Собирает разделы и пишет файл целиком
+    class Writer {
+    public:
+        void AddSection(SectionId id, std::string data);
+
+        template<typename Record>
+        void AddSection(SectionId id, const std::vector<Record> &records) {
+            static_assert(std::is_trivially_copyable_v<Record>);
+            AddSection(id, std::string(reinterpret_cast<const char *>(records.data()),
+                                       records.size() * sizeof(Record)));
+        }
+
+        void Write(std::ostream &output) const;
+
+    private:
+        std::vector<std::pair<SectionId, std::string>> sections_;
+    };
+
+    // Разделы файла, отображённого в память. Контрольная сумма заголовка, наличие обязательных
+    // разделов, их границы, выравнивание и контрольные суммы известных разделов проверяются при
+    // построении; записи читаются на месте, без копирования
+    class View {
+    public:
+        explicit View(std::string_view data);
+
+        [[nodiscard]] bool Has(SectionId id) const;
+
+        // Пустое представление, если раздела нет
+        [[nodiscard]] std::string_view Bytes(SectionId id) const;
+
+        template<typename Record>
+        [[nodiscard]] std::span<const Record> Records(SectionId id) const {
+            static_assert(std::is_trivially_copyable_v<Record>);
+            const std::string_view bytes = Bytes(id);
+            if (bytes.size() % sizeof(Record) != 0
+                || reinterpret_cast<uintptr_t>(bytes.data()) % alignof(Record) != 0) {
+                throw FormatError("Malformed base file section");
+            }
+            return {reinterpret_cast<const Record *>(bytes.data()), bytes.size() / sizeof(Record)};
+        }
+
+        [[nodiscard]] std::string_view String(StringRef ref) const;
+
+    private:
+        std::vector<std::pair<SectionId, std::string_view>> sections_;
+        std::string_view strings_;
+    };
+
+}
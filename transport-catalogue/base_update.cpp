@@ -0,0 +1,57 @@
+#include "base_update.h"
+#include "json_reader.h"
+#include "serialization.h"
+
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
+void UpdateBase(std::istream &input) {
+    JsonReader delta(input);
+    const Json::Dict &settings = delta.ProcessSerializationSettings().AsDict();
+    const std::string path(settings.at("file").AsString());
+    auto [catalogue, renderer, router, graph, stop_ids] = LoadBase(path, true);
+    const bool had_map = !renderer.GetBuiltMapJson().empty();
+
+    TCatalogue::CatalogueChanges changes;
+    if (!delta.ProcessBaseRequests().IsNull()) {
+        delta.FillCatalogue(catalogue, &changes);
+    }
+    catalogue.BuildNameIndex();
+
+    // Длина и извилистость маршрута зависят от координат и расстояний его остановок
+    std::unordered_set<std::string> changed_buses = changes.buses;
+    for (const auto &stop: changes.stops) {
+        if (!catalogue.FindStop(stop)) {
+            continue;
+        }
+        for (const auto &bus: catalogue.GetBusesOnStop(stop)) {
+            if (!changes.buses.count(bus) && changed_buses.insert(bus).second) {
+                catalogue.RecalculateRouteInfo(catalogue.GetBusInfo(bus));
+            }
+        }
+    }
+
+    if (!delta.ProcessRenderSettings().IsNull()) {
+        renderer = Render::MapRenderer(delta.ProcessRenderSettings());
+    }
+    // Сохранённая карта устарела; новая строится, если она была в базе или её просят
+    renderer.ResetMapJson();
+    if (JsonReader::PrecomputeMap(settings) || had_map) {
+        static_cast<void>(renderer.GetMapJson([&] { return catalogue.ReturnAllBus(); }));
+    }
+    // Новые настройки маршрутизации меняют веса всех рёбер
+    if (!delta.ProcessRoutingSettings().IsNull()) {
+        router = JsonReader::FillRouting(delta.ProcessRoutingSettings());
+        router.MakeRoute(catalogue);
+    } else {
+        router.UpdateRoute(catalogue, graph, stop_ids, changed_buses);
+    }
+
+    // Готовые ответы зависят от маршрутов остановок и данных маршрутов, поэтому строятся заново
+    if (JsonReader::PrecomputeResponses(settings) || !catalogue.GetResponseFragments().Empty()) {
+        catalogue.SetResponseFragments(JsonReader::MakeResponseFragments(catalogue));
+    }
+
+    SaveBase(settings, catalogue, renderer, router);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <iostream>
+
+// Изменение готовой базы (make_base --update). На вход подаётся документ того же вида, что для
+// make_base, но в base_requests — только добавленные и изменённые остановки и маршруты;
+// render_settings и routing_settings необязательны и заменяют сохранённые. Существующая
+// остановка получает новые координаты, а заданные расстояния от неё заменяют прежние;
+// маршрут с существующим названием заменяется целиком. Сведения о маршрутах и рёбра графа
+// пересчитываются только для затронутых маршрутов, остальные берутся из базы. Результат
+// совпадает с базой, построенной make_base по полному документу. Файл из serialization_settings
+// заменяется переименованием, поэтому serve подхватывает уже готовую базу
+void UpdateBase(std::istream &input);
@@ -14,6 +14,7 @@ namespace TCatalogue {
     struct Stop {
         std::string name;
         Geo::Coordinates coordinates;
+        Geo::CachedCoordinates cached_coordinates;
     };
 
 
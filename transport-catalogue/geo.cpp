@@ -2,19 +2,111 @@
 
 #include "geo.h"
 
+#include <algorithm>
 #include <cmath>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEO_HAS_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
 namespace Geo {
 
+    namespace {
+
+        const double dr = 3.1415926535 / 180.;
+
+        double CosCentralAngle(const CachedCoordinates &from, const CachedCoordinates &to) {
+            return from.sin_lat * to.sin_lat
+                   + from.cos_lat * to.cos_lat * (from.cos_lng * to.cos_lng + from.sin_lng * to.sin_lng);
+        }
+
+        void ComputeDistancesScalar(const CachedCoordinates *points, size_t count, double *result) {
+            for (size_t i = 0; i + 1 < count; ++i) {
+                result[i] = ComputeDistance(points[i], points[i + 1]);
+            }
+        }
+
+#ifdef GEO_HAS_AVX2_KERNEL
+
+        __attribute__((target("avx2,fma")))
+        void ComputeDistancesAvx2(const CachedCoordinates *points, size_t count, double *result) {
+            const size_t segments = count - 1;
+            const __m256d one = _mm256_set1_pd(1.0);
+            const __m256d minus_one = _mm256_set1_pd(-1.0);
+            size_t i = 0;
+            for (; i + 4 <= segments; i += 4) {
+                const CachedCoordinates *a = points + i;
+                const CachedCoordinates *b = points + i + 1;
+                const __m256d sin_lat_a = _mm256_set_pd(a[3].sin_lat, a[2].sin_lat, a[1].sin_lat, a[0].sin_lat);
+                const __m256d sin_lat_b = _mm256_set_pd(b[3].sin_lat, b[2].sin_lat, b[1].sin_lat, b[0].sin_lat);
+                const __m256d cos_lat_a = _mm256_set_pd(a[3].cos_lat, a[2].cos_lat, a[1].cos_lat, a[0].cos_lat);
+                const __m256d cos_lat_b = _mm256_set_pd(b[3].cos_lat, b[2].cos_lat, b[1].cos_lat, b[0].cos_lat);
+                const __m256d sin_lng_a = _mm256_set_pd(a[3].sin_lng, a[2].sin_lng, a[1].sin_lng, a[0].sin_lng);
+                const __m256d sin_lng_b = _mm256_set_pd(b[3].sin_lng, b[2].sin_lng, b[1].sin_lng, b[0].sin_lng);
+                const __m256d cos_lng_a = _mm256_set_pd(a[3].cos_lng, a[2].cos_lng, a[1].cos_lng, a[0].cos_lng);
+                const __m256d cos_lng_b = _mm256_set_pd(b[3].cos_lng, b[2].cos_lng, b[1].cos_lng, b[0].cos_lng);
+
+                const __m256d cos_dlng = _mm256_fmadd_pd(sin_lng_a, sin_lng_b, _mm256_mul_pd(cos_lng_a, cos_lng_b));
+                __m256d cos_angle = _mm256_fmadd_pd(_mm256_mul_pd(cos_lat_a, cos_lat_b), cos_dlng,
+                                                    _mm256_mul_pd(sin_lat_a, sin_lat_b));
+                cos_angle = _mm256_max_pd(_mm256_min_pd(cos_angle, one), minus_one);
+
+                alignas(32) double lanes[4];
+                _mm256_store_pd(lanes, cos_angle);
+                for (size_t lane = 0; lane < 4; ++lane) {
+                    const bool same = a[lane].lat_rad == b[lane].lat_rad && a[lane].lng_rad == b[lane].lng_rad;
+                    result[i + lane] = same ? 0.0 : std::acos(lanes[lane]) * earth_radius;
+                }
+            }
+            ComputeDistancesScalar(points + i, count - i, result + i);
+        }
+
+        bool HasAvx2() {
+            static const bool has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            return has_avx2;
+        }
+
+#endif
+
+    }  // namespace
+
+    CachedCoordinates::CachedCoordinates(Coordinates coordinates)
+            : lat_rad(coordinates.lat * dr), lng_rad(coordinates.lng * dr),
+              sin_lat(std::sin(lat_rad)), cos_lat(std::cos(lat_rad)),
+              sin_lng(std::sin(lng_rad)), cos_lng(std::cos(lng_rad)) {
+    }
+
     double ComputeDistance(Coordinates from, Coordinates to) {
         using namespace std;
         if (from == to) {
             return 0;
         }
-        static const double dr = 3.1415926535 / 180.;
         return acos(sin(from.lat * dr) * sin(to.lat * dr)
                     + cos(from.lat * dr) * cos(to.lat * dr) * cos(abs(from.lng - to.lng) * dr))
                * earth_radius;
     }
 
-}  // namespace geo
\ No newline at end of file
+    double ComputeDistance(const CachedCoordinates &from, const CachedCoordinates &to) {
+        if (from.lat_rad == to.lat_rad && from.lng_rad == to.lng_rad) {
+            return 0;
+        }
+        return std::acos(std::clamp(CosCentralAngle(from, to), -1.0, 1.0)) * earth_radius;
+    }
+
+    std::vector<double> ComputeDistances(const std::vector<CachedCoordinates> &points) {
+        if (points.size() < 2) {
+            return {};
+        }
+        std::vector<double> result(points.size() - 1);
+#ifdef GEO_HAS_AVX2_KERNEL
+        if (HasAvx2()) {
+            ComputeDistancesAvx2(points.data(), points.size(), result.data());
+            return result;
+        }
+#endif
+        ComputeDistancesScalar(points.data(), points.size(), result.data());
+        return result;
+    }
+
+}  // namespace geo
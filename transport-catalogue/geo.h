@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include <vector>
 
 namespace Geo {
 
@@ -19,6 +20,29 @@ namespace Geo {
         }
     };
 
+    // Координаты с заранее посчитанной тригонометрией: расстояние между двумя такими точками
+    // сводится к скалярному произведению единичных векторов и одному acos.
+    struct CachedCoordinates {
+        CachedCoordinates() = default;
+
+        explicit CachedCoordinates(Coordinates coordinates);
+
+        double lat_rad = 0.0;
+        double lng_rad = 0.0;
+        double sin_lat = 0.0;
+        double cos_lat = 1.0;
+        double sin_lng = 0.0;
+        double cos_lng = 1.0;
+    };
+
     double ComputeDistance(Coordinates from, Coordinates to);
 
-}
\ No newline at end of file
+    double ComputeDistance(const CachedCoordinates &from, const CachedCoordinates &to);
+
+    // Расстояния между соседними точками последовательности: result[i] = distance(points[i], points[i + 1]).
+    // На процессорах с AVX2 считается по четыре отрезка за раз, иначе используется скалярный вариант.
+    // Результат отличается от ComputeDistance(Coordinates, Coordinates) только ошибками округления:
+    // не более 2e-3 м для отрезков длиннее 10 м и не более 0.2 м для совпадающих или почти совпадающих точек.
+    std::vector<double> ComputeDistances(const std::vector<CachedCoordinates> &points);
+
+}
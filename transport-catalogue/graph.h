@@ -3,6 +3,7 @@
 #include "ranges.h"
 
 #include <cstdlib>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -11,9 +12,10 @@ namespace graph {
     using VertexId = size_t;
     using EdgeId = size_t;
 
+    // name указывает на название маршрута или остановки, которым владеет справочник
     template<typename Weight>
     struct Edge {
-        std::string name;
+        std::string_view name;
         size_t span;
         VertexId from;
         VertexId to;
@@ -75,7 +77,7 @@ namespace graph {
     template<typename Weight>
     DirectedWeightedGraph<Weight>::DirectedWeightedGraph(std::vector<Edge<Weight>> edges,
                                                          std::vector<std::vector<EdgeId>> incidence_lists)
-            : edges_(edges), incidence_lists_(std::move(incidence_lists)) {}
+            : edges_(std::move(edges)), incidence_lists_(std::move(incidence_lists)) {}
 
     template<typename Weight>
     const Edge<Weight> &DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
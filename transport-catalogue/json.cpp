@@ -1,4 +1,11 @@
 #include "json.h"
+#include "json_scanner.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <mutex>
 
 using namespace std;
 
@@ -6,207 +13,253 @@ namespace Json {
 
     namespace {
 
-        using Number = std::variant<int, double>;
+        using Detail::IsSpace;
+
+        // Массивы короче этого порога разбираются последовательно: запуск потоков дороже
+        constexpr ptrdiff_t PARALLEL_ARRAY_BYTES = 1 << 20;
+        constexpr size_t PARALLEL_MIN_ELEMENTS = 256;
+
+        // Разбирает JSON из непрерывного буфера в дерево Node
+        class Parser : private Detail::Scanner {
+        public:
+            // Если задан arenas, большие массивы верхних уровней разбираются параллельно;
+            // каждый поток размещает узлы в собственной арене, добавляемой в arenas
+            explicit Parser(std::string_view text,
+                            std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+                            std::vector<std::unique_ptr<Arena>> *arenas = nullptr)
+                    : Scanner(text), resource_(resource), arenas_(arenas) {
+            }
+
+            Node LoadNode();
+
+        private:
+            String LoadString();
+
+            Node LoadNumber();
+
+            Node LoadArray();
+
+            Node LoadDict();
 
-        Node LoadNode(istream &input);
+            // Находит закрывающую скобку массива, начинающегося в текущей позиции, и запятые
+            // между его элементами, не разбирая сами элементы
+            const char *ScanArray(std::vector<const char *> &separators) const;
 
-        Node LoadNull(istream &input) {
-            const string nameNull = "null";
-            for (size_t i = 0; i < nameNull.size(); i++) {
-                if (nameNull.at(i) == input.get()) continue;
-                else throw ParsingError("Null parsing error");
+            bool TryLoadArrayParallel(Array &result);
+
+            std::pmr::memory_resource *resource_;
+            std::vector<std::unique_ptr<Arena>> *arenas_;
+            int depth_ = 0;
+        };
+
+        const char *Parser::ScanArray(std::vector<const char *> &separators) const {
+            int depth = 0;
+            for (const char *it = pos_; it != end_;) {
+                const char c = *it;
+                if (c == '"') {
+                    // Внутри строки структурных символов нет: перескакиваем её целиком
+                    ++it;
+                    while (true) {
+                        it = Detail::FindStringSpecial(it, end_);
+                        if (it == end_) {
+                            throw ParsingError("String parsing error");
+                        }
+                        if (*it == '"') {
+                            ++it;
+                            break;
+                        }
+                        it += (*it == '\\' && end_ - it > 1) ? 2 : 1;
+                    }
+                    continue;
+                }
+                if (c == '[' || c == '{') {
+                    ++depth;
+                } else if (c == ']' || c == '}') {
+                    if (depth == 0) {
+                        if (c != ']') {
+                            throw ParsingError("Array error");
+                        }
+                        return it;
+                    }
+                    --depth;
+                } else if (c == ',' && depth == 0) {
+                    separators.push_back(it);
+                }
+                ++it;
             }
-            return {};
+            throw ParsingError("Array error");
+        }
+
+        bool Parser::TryLoadArrayParallel(Array &result) {
+            if (!arenas_ || depth_ > 1 || end_ - pos_ < PARALLEL_ARRAY_BYTES || Parallel::ThreadCount() < 2) {
+                return false;
+            }
+
+            std::vector<const char *> separators;
+            const char *close = ScanArray(separators);
+            const size_t count = separators.size() + 1;
+            if (count < PARALLEL_MIN_ELEMENTS) {
+                return false;
+            }
+            separators.push_back(close);
+
+            std::vector<Node> nodes(count);
+            std::mutex arenas_mutex;
+            Parallel::ForEachRange(count, PARALLEL_MIN_ELEMENTS, [&](size_t begin, size_t end) {
+                // Арена сразу передаётся документу: даже при ошибке разбора она должна
+                // пережить уже созданные в ней узлы
+                Arena *arena;
+                {
+                    std::lock_guard guard(arenas_mutex);
+                    arena = arenas_->emplace_back(std::make_unique<Arena>()).get();
+                }
+                for (size_t i = begin; i < end; ++i) {
+                    const char *element_begin = i == 0 ? pos_ : separators[i - 1] + 1;
+                    Parser parser(std::string_view(element_begin, static_cast<size_t>(separators[i] - element_begin)),
+                                  arena);
+                    nodes[i] = parser.LoadNode();
+                    parser.SkipWhitespace();
+                    if (parser.pos_ != parser.end_) {
+                        throw ParsingError("Array error");
+                    }
+                }
+            });
+
+            // Перемещённые узлы сохраняют аллокаторы своих арен
+            result.reserve(count);
+            std::move(nodes.begin(), nodes.end(), std::back_inserter(result));
+            pos_ = close + 1;
+            return true;
         }
 
 // Считывает содержимое строкового литерала JSON-документа
 // Функцию следует использовать после считывания открывающего символа ":
-        std::string LoadString(std::istream &input) {
-            using namespace std::literals;
-
-            auto it = std::istreambuf_iterator<char>(input);
-            auto end = std::istreambuf_iterator<char>();
-            std::string s;
+        String Parser::LoadString() {
+            String s(resource_);
             while (true) {
-                if (it == end) {
+                // Копируем обычные символы целыми отрезками
+                const char *special = ScanStringRun();
+                s.append(pos_, special);
+                pos_ = special;
+                if (pos_ == end_) {
                     // Поток закончился до того, как встретили закрывающую кавычку?
                     throw ParsingError("String parsing error");
                 }
-                const char ch = *it;
+                const char ch = *pos_++;
                 if (ch == '"') {
                     // Встретили закрывающую кавычку
-                    ++it;
                     break;
                 } else if (ch == '\\') {
                     // Встретили начало escape-последовательности
-                    ++it;
-                    if (it == end) {
-                        // Поток завершился сразу после символа обратной косой черты
-                        throw ParsingError("String parsing error");
-                    }
-                    const char escaped_char = *(it);
-                    // Обрабатываем одну из последовательностей: \\, \n, \t, \r, \"
-                    switch (escaped_char) {
-                        case 'n':
-                            s.push_back('\n');
-                            break;
-                        case 't':
-                            s.push_back('\t');
-                            break;
-                        case 'r':
-                            s.push_back('\r');
-                            break;
-                        case '"':
-                            s.push_back('"');
-                            break;
-                        case '\\':
-                            s.push_back('\\');
-                            break;
-                        default:
-                            // Встретили неизвестную escape-последовательность
-                            throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
-                    }
-                } else if (ch == '\n' || ch == '\r') {
+                    AppendEscape(s);
+                } else {
                     // Строковый литерал внутри- JSON не может прерываться символами \r или \n
                     throw ParsingError("Unexpected end of line"s);
-                } else {
-                    // Просто считываем очередной символ и помещаем его в результирующую строку
-                    s.push_back(ch);
                 }
-                ++it;
             }
 
             return s;
         }
 
-        Node LoadNumber(std::istream &input) {
-            using namespace std::literals;
-
-            std::string parsed_num;
-
-            // Считывает в parsed_num очередной символ из input
-            auto read_char = [&parsed_num, &input] {
-                parsed_num += static_cast<char>(input.get());
-                if (!input) {
-                    throw ParsingError("Failed to read number from stream"s);
-                }
-            };
-
-            // Считывает одну или более цифр в parsed_num из input
-            auto read_digits = [&input, read_char] {
-                if (!std::isdigit(input.peek())) {
-                    throw ParsingError("A digit is expected"s);
-                }
-                while (std::isdigit(input.peek())) {
-                    read_char();
-                }
-            };
-
-            if (input.peek() == '-') {
-                read_char();
-            }
-            if (input.peek() == '0') {
-                read_char();
-            } else {
-                read_digits();
-            }
-
-            bool is_int = true;
-            // Парсим дробную часть числа
-            if (input.peek() == '.') {
-                read_char();
-                read_digits();
-                is_int = false;
-            }
-
-            // Парсим экспоненциальную часть числа
-            if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-                read_char();
-                if (ch = input.peek(); ch == '+' || ch == '-') {
-                    read_char();
-                }
-                read_digits();
-                is_int = false;
-            }
-
-            try {
-                if (is_int) {
-                    try {
-                        return std::stoi(parsed_num);
-                    }
-                    catch (...) {
-                    }
+        Node Parser::LoadNumber() {
+            const auto [begin, end, is_int] = ScanNumber();
+            if (is_int) {
+                int value = 0;
+                if (auto [ptr, ec] = std::from_chars(begin, end, value); ec == std::errc() && ptr == end) {
+                    return value;
                 }
-                return std::stod(parsed_num);
             }
-            catch (...) {
-                throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
+            double value = 0.0;
+            if (auto [ptr, ec] = std::from_chars(begin, end, value); ec == std::errc() && ptr == end) {
+                return value;
             }
+            throw ParsingError("Failed to convert "s + std::string(begin, end) + " to number"s);
         }
 
-        Node LoadBool(istream &input) {
-            const string nameFalse = "false";
-            const string nameTrue = "true";
-            char c = input.get();
-            bool value = (c == 't');
-            std::string const *name = value ? &nameTrue : &nameFalse;
-            for (size_t i = 1; i < name->size(); i++) {
-                if (name->at(i) == input.get()) continue;
-                else throw ParsingError("Bool error");
+        Node Parser::LoadArray() {
+            Array result(resource_);
+            if (NextToken() == ']') {
+                ++pos_;
+                return Node(std::move(result));
+            }
+            if (TryLoadArrayParallel(result)) {
+                return Node(std::move(result));
             }
-            return Node(value);
-        }
 
-        Node LoadArray(istream &input) {
-            Array result;
-            if (input.peek() == -1) throw ParsingError("Array error");
+            ++depth_;
 
-            for (char c; input >> c && c != ']';) {
-                if (c != ',') {
-                    input.putback(c);
+            while (true) {
+                result.push_back(LoadNode());
+                const char c = NextToken();
+                ++pos_;
+                if (c == ']') {
+                    break;
+                } else if (c != ',') {
+                    throw ParsingError("Array error");
                 }
-                result.push_back(LoadNode(input));
             }
 
+            --depth_;
             return Node(std::move(result));
         }
 
-        Node LoadDict(istream &input) {
-            Dict result;
-            if (input.peek() == -1) throw ParsingError("Array error");
+        Node Parser::LoadDict() {
+            Dict result(resource_);
+            if (NextToken() == '}') {
+                ++pos_;
+                return Node(std::move(result));
+            }
+
+            ++depth_;
 
-            for (char c; input >> c && c != '}';) {
-                if (c == ',') {
-                    input >> c;
+            while (true) {
+                if (NextToken() != '"') {
+                    throw ParsingError("Dict key expected");
                 }
+                ++pos_;
+                String key = LoadString();
+                if (NextToken() != ':') {
+                    throw ParsingError("Dict error");
+                }
+                ++pos_;
+                result.emplace(std::move(key), LoadNode());
 
-                string key = LoadString(input);
-                input >> c;
-                result.insert({std::move(key), LoadNode(input)});
+                const char c = NextToken();
+                ++pos_;
+                if (c == '}') {
+                    break;
+                } else if (c != ',') {
+                    throw ParsingError("Dict error");
+                }
             }
 
+            --depth_;
             return Node(std::move(result));
         }
 
-        Node LoadNode(istream &input) {
-            char c;
-            input >> c;
+        Node Parser::LoadNode() {
+            const char c = NextToken();
 
             if (c == 'n') {
-                input.putback(c);
-                return LoadNull(input);
+                ExpectKeyword("null"sv);
+                return Node{nullptr};
             } else if (c == '"') {
-                return LoadString(input);
-            } else if (c == 't' || c == 'f') {
-                input.putback(c);
-                return LoadBool(input);
+                ++pos_;
+                return LoadString();
+            } else if (c == 't') {
+                ExpectKeyword("true"sv);
+                return Node{true};
+            } else if (c == 'f') {
+                ExpectKeyword("false"sv);
+                return Node{false};
             } else if (c == '[') {
-                return LoadArray(input);
+                ++pos_;
+                return LoadArray();
             } else if (c == '{') {
-                return LoadDict(input);
+                ++pos_;
+                return LoadDict();
             } else {
-                input.putback(c);
-                return LoadNumber(input);
+                return LoadNumber();
             }
         }
 
@@ -217,6 +270,10 @@ namespace Json {
     }
 
     Node::Node(std::string value)
+            : variant(String(value)) {
+    }
+
+    Node::Node(String value)
             : variant(std::move(value)) {
     }
 
@@ -257,7 +314,7 @@ namespace Json {
     }
 
     bool Node::IsString() const {
-        return holds_alternative<std::string>(*this);
+        return holds_alternative<String>(*this);
     }
 
     bool Node::IsNull() const {
@@ -288,9 +345,9 @@ namespace Json {
         return std::get<double>(*this);
     }
 
-    const std::string &Node::AsString() const {
+    const String &Node::AsString() const {
         if (!IsString()) throw std::logic_error("wrong type");
-        return std::get<std::string>(*this);
+        return std::get<String>(*this);
     }
 
     const Array &Node::AsArray() const {
@@ -335,6 +392,26 @@ namespace Json {
             : root_(std::move(root)) {
     }
 
+    Document::Document(std::string_view text, std::unique_ptr<Arena> arena) {
+        Arena *first = arenas_.emplace_back(std::move(arena)).get();
+        // Корень строится прямо в члене, без промежуточного Node
+        new(&root_) Node(Parser(text, first, &arenas_).LoadNode());
+    }
+
+    Document::Document(const Document &other)
+            : root_(other.root_) {
+    }
+
+    Document::Document(Document &&other) noexcept
+            : arenas_(std::move(other.arenas_)), root_(std::move(other.root_)) {
+    }
+
+    Document::~Document() {
+        if (arenas_.empty()) {
+            root_.~Node();
+        }
+    }
+
     const Node &Document::GetRoot() const {
         return root_;
     }
@@ -347,74 +424,462 @@ namespace Json {
         return !(root_ == rhs.root_);
     }
 
+    Document Load(std::string_view text) {
+        return Document{text, std::make_unique<Arena>()};
+    }
+
     Document Load(istream &input) {
-        return Document{LoadNode(input)};
+        // Читаем вход целиком крупными блоками в обход посимвольного форматированного ввода
+        std::string buffer;
+        std::streambuf *source = input.rdbuf();
+        std::vector<char> chunk(1 << 20);
+        for (std::streamsize read; (read = source->sgetn(chunk.data(), static_cast<std::streamsize>(chunk.size()))) > 0;) {
+            buffer.append(chunk.data(), static_cast<size_t>(read));
+        }
+        return Load(std::string_view(buffer));
     }
 
-    void ContainerPrinter::operator()(std::nullptr_t) {
-        out << "null"s;
+    Reader::Reader(std::istream &input)
+            : input_(input) {
     }
 
-    void ContainerPrinter::operator()(const std::string &value) {
-        out << "\""sv;
-        for (const char &c: value) {
-            if (c == '\n') {
-                out << "\\n"sv;
-                continue;
+    bool Reader::Fill() {
+        // Уже разобранную часть буфера выбрасываем, чтобы память не росла вместе с входом
+        const size_t consumed = std::min(pos_, pinned_);
+        buffer_.erase(0, consumed);
+        pos_ -= consumed;
+        if (pinned_ != std::string::npos) {
+            pinned_ -= consumed;
+        }
+        const size_t old_size = buffer_.size();
+        buffer_.resize(old_size + (1 << 20));
+        const std::streamsize read = input_.rdbuf()->sgetn(buffer_.data() + old_size, 1 << 20);
+        buffer_.resize(old_size + static_cast<size_t>(std::max<std::streamsize>(read, 0)));
+        return read > 0;
+    }
+
+    bool Reader::SkipWhitespace() {
+        while (true) {
+            while (pos_ != buffer_.size() && IsSpace(buffer_[pos_])) {
+                ++pos_;
             }
-            if (c == '\r') {
-                out << "\\r"sv;
-                continue;
+            if (pos_ != buffer_.size()) {
+                return true;
+            }
+            if (!Fill()) {
+                return false;
+            }
+        }
+    }
+
+    char Reader::NextToken() {
+        if (!SkipWhitespace()) {
+            throw ParsingError("Unexpected end of input"s);
+        }
+        return buffer_[pos_];
+    }
+
+    void Reader::BeginDict() {
+        if (NextToken() != '{') {
+            throw ParsingError("Dict expected"s);
+        }
+        ++pos_;
+        first_in_container_.push_back(true);
+    }
+
+    void Reader::BeginArray() {
+        if (NextToken() != '[') {
+            throw ParsingError("Array expected"s);
+        }
+        ++pos_;
+        first_in_container_.push_back(true);
+    }
+
+    bool Reader::NextInContainer(char close) {
+        if (first_in_container_.empty()) {
+            throw ParsingError("Not inside a container"s);
+        }
+        char c = NextToken();
+        if (c == close) {
+            ++pos_;
+            first_in_container_.pop_back();
+            return false;
+        }
+        if (!first_in_container_.back()) {
+            if (c != ',') {
+                throw ParsingError("',' expected"s);
+            }
+            ++pos_;
+            NextToken();
+        }
+        first_in_container_.back() = false;
+        return true;
+    }
+
+    bool Reader::NextKey(std::string &key) {
+        if (!NextInContainer('}')) {
+            return false;
+        }
+        if (buffer_[pos_] != '"') {
+            throw ParsingError("Dict key expected"s);
+        }
+        key = ReadNode().AsString();
+        if (NextToken() != ':') {
+            throw ParsingError("Dict error"s);
+        }
+        ++pos_;
+        return true;
+    }
+
+    bool Reader::NextItem() {
+        return NextInContainer(']');
+    }
+
+    bool Reader::NextItems(std::vector<std::string_view> &items, size_t max_bytes) {
+        // Пока пачка собирается, буфер только дописывается, поэтому запоминаем смещения
+        std::vector<std::pair<size_t, size_t>> spans;
+        pinned_ = pos_;
+        bool more = true;
+        for (size_t total = 0; total < max_bytes;) {
+            if (!NextItem()) {
+                more = false;
+                break;
+            }
+            const size_t size = FindValueEnd();
+            if (size == 0) {
+                throw ParsingError("Value expected"s);
             }
-            if (c == '\"') out << "\\"sv;
-            if (c == '\t') {
-                out << "\t"sv;
+            spans.emplace_back(pos_ - pinned_, size);
+            pos_ += size;
+            total += size;
+        }
+
+        items.clear();
+        const std::string_view batch = std::string_view(buffer_).substr(pinned_);
+        for (const auto &[offset, size]: spans) {
+            items.push_back(batch.substr(offset, size));
+        }
+        pinned_ = std::string::npos;
+        return more;
+    }
+
+    Node Reader::ReadNode(std::pmr::memory_resource *resource) {
+        return Parser(ReadRaw(), resource).LoadNode();
+    }
+
+    std::string_view Reader::ReadRaw() {
+        NextToken();
+        const size_t size = FindValueEnd();
+        if (size == 0) {
+            throw ParsingError("Value expected"s);
+        }
+        const std::string_view result = std::string_view(buffer_).substr(pos_, size);
+        pos_ += size;
+        return result;
+    }
+
+    // Находит границу значения, начинающегося в текущей позиции, при необходимости дочитывая вход.
+    // Возвращает длину значения в байтах
+    size_t Reader::FindValueEnd() {
+        size_t offset = 0;
+        int depth = 0;
+        bool in_string = false;
+        bool escaped = false;
+        while (true) {
+            if (pos_ + offset == buffer_.size()) {
+                if (!Fill()) {
+                    if (depth == 0 && !in_string) {
+                        return offset;
+                    }
+                    throw ParsingError("Unexpected end of input"s);
+                }
                 continue;
             }
-            if (c == '\\') out << "\\"sv;
-            out << c;
+            const char c = buffer_[pos_ + offset];
+            if (in_string) {
+                if (escaped) {
+                    escaped = false;
+                } else if (c == '\\') {
+                    escaped = true;
+                } else if (c == '"') {
+                    in_string = false;
+                    if (depth == 0) {
+                        return offset + 1;
+                    }
+                }
+            } else if (c == '"') {
+                in_string = true;
+            } else if (c == '{' || c == '[') {
+                ++depth;
+            } else if (c == '}' || c == ']') {
+                if (depth == 0) {
+                    return offset;
+                }
+                if (--depth == 0) {
+                    return offset + 1;
+                }
+            } else if (depth == 0 && (c == ',' || c == ':' || IsSpace(c))) {
+                return offset;
+            }
+            ++offset;
+        }
+    }
+
+    Writer::Writer(std::ostream &output)
+            : output_(output), buffer_(new char[CAPACITY]) {
+    }
+
+    Writer::~Writer() {
+        Flush();
+    }
+
+    void Writer::Flush() {
+        if (size_ != 0) {
+            output_.rdbuf()->sputn(buffer_.get(), static_cast<std::streamsize>(size_));
+            size_ = 0;
+        }
+    }
+
+    void Writer::Write(char c) {
+        if (size_ == CAPACITY) {
+            Flush();
+        }
+        buffer_[size_++] = c;
+    }
+
+    void Writer::Write(std::string_view text) {
+        if (text.size() > CAPACITY - size_) {
+            Flush();
+            if (text.size() > CAPACITY) {
+                // Длинный фрагмент отправляем в поток напрямую, минуя буфер
+                output_.rdbuf()->sputn(text.data(), static_cast<std::streamsize>(text.size()));
+                return;
+            }
+        }
+        std::copy(text.begin(), text.end(), buffer_.get() + size_);
+        size_ += text.size();
+    }
+
+    void Writer::WriteInt(int value) {
+        char digits[16];
+        const auto [end, ec] = std::to_chars(std::begin(digits), std::end(digits), value);
+        Write(std::string_view(digits, static_cast<size_t>(end - digits)));
+    }
+
+    void Writer::WriteDouble(double value) {
+        char digits[32];
+        const auto [end, ec] = std::to_chars(std::begin(digits), std::end(digits), value,
+                                             std::chars_format::general, 6);
+        Write(std::string_view(digits, static_cast<size_t>(end - digits)));
+    }
+
+    void Writer::WriteBool(bool value) {
+        Write(value ? "true"sv : "false"sv);
+    }
+
+    void Writer::WriteString(std::string_view value) {
+        Write('"');
+        WriteEscaped(value);
+        Write('"');
+    }
+
+    void Writer::WriteEscaped(std::string_view text) {
+        const char *it = text.data();
+        const char *end = text.data() + text.size();
+        while (true) {
+            // Обычные символы копируем целыми отрезками до ближайшего требующего экранирования
+            const char *special = Detail::FindStringSpecial(it, end);
+            Write(std::string_view(it, static_cast<size_t>(special - it)));
+            if (special == end) {
+                break;
+            }
+            switch (*special) {
+                case '"':
+                case '\\':
+                    Write('\\');
+                    Write(*special);
+                    break;
+                case '\n':
+                    Write("\\n"sv);
+                    break;
+                case '\r':
+                    Write("\\r"sv);
+                    break;
+                case '\t':
+                    Write("\\t"sv);
+                    break;
+                case '\b':
+                    Write("\\b"sv);
+                    break;
+                case '\f':
+                    Write("\\f"sv);
+                    break;
+                default: {
+                    // Остальные управляющие символы записываются как \u00XX
+                    static constexpr char HEX[] = "0123456789abcdef";
+                    const auto code = static_cast<unsigned char>(*special);
+                    const char escape[] = {'\\', 'u', '0', '0', HEX[code >> 4], HEX[code & 0xF]};
+                    Write(std::string_view(escape, sizeof(escape)));
+                }
+            }
+            it = special + 1;
+        }
+    }
+
+    void Writer::WriteNode(const Node &node) {
+        std::visit(ContainerPrinter{*this}, node.GetValue());
+    }
+
+    void Writer::BeforeValue() {
+        if (after_key_) {
+            after_key_ = false;
+            return;
+        }
+        if (!first_in_container_.empty()) {
+            if (!first_in_container_.back()) {
+                Write(", "sv);
+            }
+            first_in_container_.back() = false;
+        }
+    }
+
+    Writer &Writer::StartDict() {
+        BeforeValue();
+        Write("{ "sv);
+        first_in_container_.push_back(true);
+        return *this;
+    }
+
+    Writer &Writer::Key(std::string_view key) {
+        BeforeValue();
+        Write('"');
+        Write(key);
+        Write("\": "sv);
+        after_key_ = true;
+        return *this;
+    }
+
+    Writer &Writer::EndDict() {
+        first_in_container_.pop_back();
+        Write(" }"sv);
+        return *this;
+    }
+
+    Writer &Writer::StartArray() {
+        BeforeValue();
+        Write('[');
+        first_in_container_.push_back(true);
+        return *this;
+    }
+
+    Writer &Writer::EndArray() {
+        first_in_container_.pop_back();
+        Write(']');
+        return *this;
+    }
+
+    Writer &Writer::Value(std::nullptr_t) {
+        BeforeValue();
+        Write("null"sv);
+        return *this;
+    }
+
+    Writer &Writer::Value(int value) {
+        BeforeValue();
+        WriteInt(value);
+        return *this;
+    }
+
+    Writer &Writer::Value(double value) {
+        BeforeValue();
+        WriteDouble(value);
+        return *this;
+    }
+
+    Writer &Writer::Value(bool value) {
+        BeforeValue();
+        WriteBool(value);
+        return *this;
+    }
+
+    Writer &Writer::Value(std::string_view value) {
+        BeforeValue();
+        WriteString(value);
+        return *this;
+    }
+
+    Writer &Writer::Value(const char *value) {
+        return Value(std::string_view(value));
+    }
+
+    Writer &Writer::RawValue(std::string_view json) {
+        BeforeValue();
+        Write(json);
+        return *this;
+    }
+
+    std::streamsize EscapingBuf::xsputn(const char *s, std::streamsize count) {
+        writer_.WriteEscaped(std::string_view(s, static_cast<size_t>(count)));
+        return count;
+    }
+
+    EscapingBuf::int_type EscapingBuf::overflow(int_type c) {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            const char ch = traits_type::to_char_type(c);
+            writer_.WriteEscaped(std::string_view(&ch, 1));
         }
-        out << "\""sv;
+        return traits_type::not_eof(c);
+    }
+
+    void ContainerPrinter::operator()(std::nullptr_t) {
+        out.Write("null"sv);
+    }
+
+    void ContainerPrinter::operator()(const String &value) {
+        out.WriteString(value);
     }
 
     void ContainerPrinter::operator()(int value) {
-        out << value;
+        out.WriteInt(value);
     }
 
     void ContainerPrinter::operator()(double value) {
-        out << value;
+        out.WriteDouble(value);
     }
 
     void ContainerPrinter::operator()(bool value) {
-        out << std::boolalpha << value;
+        out.WriteBool(value);
     }
 
-    void ContainerPrinter::operator()(Array array) {
-        out << "["sv;
+    void ContainerPrinter::operator()(const Array &array) {
+        out.Write('[');
         bool first = true;
         for (const auto &elem: array) {
             if (first) first = false;
-            else out << ", "s;
+            else out.Write(", "sv);
 
-            std::visit(ContainerPrinter{out}, elem.GetValue());
+            out.WriteNode(elem);
         }
-        out << "]"sv;
+        out.Write(']');
     }
 
     void ContainerPrinter::operator()(const Dict& dict) {
-        out << "{ "sv;
+        out.Write("{ "sv);
         bool first = true;
         for (auto &[key, node]: dict) {
             if (first) first = false;
-            else out << ", "s;
-            out << "\"" << key << "\": ";
-            std::visit(ContainerPrinter{out}, node.GetValue());
+            else out.Write(", "sv);
+            out.Write('"');
+            out.Write(key);
+            out.Write("\": "sv);
+            out.WriteNode(node);
         }
-        out << " }"sv;
+        out.Write(" }"sv);
     }
 
     void Print(const Document &document, std::ostream &out) {
-        std::visit(ContainerPrinter{out}, document.GetRoot().GetValue());
+        Writer writer(out);
+        writer.WriteNode(document.GetRoot());
     }
 
 }
\ No newline at end of file
@@ -2,22 +2,30 @@
 
 #include <iostream>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <variant>
 
 namespace Json {
 
+    // Контейнеры узлов используют polymorphic_allocator: дерево можно целиком разместить в арене
     class Node;
-    using Dict = std::map<std::string, Node>;
-    using Array = std::vector<Node>;
+    using String = std::pmr::string;
+    using Dict = std::pmr::map<String, Node, std::less<>>;
+    using Array = std::pmr::vector<Node>;
+
+    // Монотонная арена для одного документа или одного запроса: освобождается одним вызовом
+    using Arena = std::pmr::monotonic_buffer_resource;
 
     class ParsingError : public std::runtime_error {
     public:
         using runtime_error::runtime_error;
     };
 
-    class Node final : private std::variant<std::nullptr_t, Array, Dict, bool, int, double, std::string>{
+    class Node final : private std::variant<std::nullptr_t, Array, Dict, bool, int, double, String>{
     public:
         using variant::variant;
         using Value = variant;
@@ -28,6 +36,8 @@ namespace Json {
 
         Node(std::string value);
 
+        Node(String value);
+
         Node(int value);
 
         Node(double value);
@@ -62,7 +72,7 @@ namespace Json {
 
         double AsDouble() const;
 
-        const std::string &AsString() const;
+        const String &AsString() const;
 
         const Array &AsArray() const;
 
@@ -84,6 +94,18 @@ namespace Json {
     public:
         explicit Document(Node root);
 
+        Document(const Document &other);
+
+        // Забирает арены вместе с деревом: у other их не остаётся, и его опустевший корень
+        // разрушается обычным образом
+        Document(Document &&other) noexcept;
+
+        Document &operator=(const Document &) = delete;
+
+        Document &operator=(Document &&) = delete;
+
+        ~Document();
+
         [[nodiscard]] const Node &GetRoot() const;
 
         bool operator==(const Document &rhs) const;
@@ -91,19 +113,175 @@ namespace Json {
         bool operator!=(const Document &rhs) const;
 
     private:
-        Node root_;
+        friend Document Load(std::string_view text);
+
+        // Разбирает text, размещая все узлы в arena и в аренах, которые парсер добавит сам
+        Document(std::string_view text, std::unique_ptr<Arena> arena);
+
+        // Если арены есть, в них лежит всё дерево
+        std::vector<std::unique_ptr<Arena>> arenas_;
+        // Деструктор корня вызывается явно и только для дерева вне арен: дерево в аренах
+        // не обходится, а освобождается вместе с ними
+        union {
+            Node root_;
+        };
     };
 
     Document Load(std::istream &input);
 
+    // Разбор документа из непрерывного буфера (например, целиком прочитанного входа).
+    // Большие массивы в корне документа и на первом уровне вложенности разбираются параллельно
+    Document Load(std::string_view text);
+
     void Print(const Document &document, std::ostream &output);
 
+    // Потоковый (pull) разбор: вход читается блоками, в памяти целиком разбирается только
+    // запрошенное значение. Позволяет обходить большие массивы поэлементно, не строя Document.
+    class Reader {
+    public:
+        explicit Reader(std::istream &input);
+
+        // Считывает '{'; ключи затем перебираются через NextKey
+        void BeginDict();
+
+        // Считывает очередной ключ вместе с ':'. Возвращает false, если словарь закончился
+        bool NextKey(std::string &key);
+
+        // Считывает '['; элементы затем перебираются через NextItem
+        void BeginArray();
+
+        // Возвращает true, если в текущем массиве есть ещё элемент. В конце массива считывает ']'
+        bool NextItem();
+
+        // Считывает тексты элементов текущего массива подряд, пока их суммарный размер не превысит
+        // max_bytes. Представления действительны до следующего обращения к Reader. Возвращает false,
+        // если массив закончился (items при этом может быть непустым)
+        bool NextItems(std::vector<std::string_view> &items, size_t max_bytes);
+
+        // Разбирает очередное значение целиком, размещая его узлы в resource
+        Node ReadNode(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+        // Возвращает текст очередного значения без разбора. Представление действительно
+        // до следующего обращения к Reader
+        std::string_view ReadRaw();
+
+    private:
+        bool Fill();
+
+        bool SkipWhitespace();
+
+        char NextToken();
+
+        bool NextInContainer(char close);
+
+        size_t FindValueEnd();
+
+        std::istream &input_;
+        std::string buffer_;
+        size_t pos_ = 0;
+        // Начало данных, которые нельзя выбрасывать при дочитывании
+        size_t pinned_ = std::string::npos;
+        std::vector<bool> first_in_container_;
+    };
+
+    // Буферизованный вывод JSON: текст копится в большом буфере и уходит в поток крупными блоками.
+    // Остаток записывается при уничтожении или явном вызове Flush
+    class Writer {
+    public:
+        explicit Writer(std::ostream &output);
+
+        Writer(const Writer &) = delete;
+
+        Writer &operator=(const Writer &) = delete;
+
+        ~Writer();
+
+        void Write(char c);
+
+        void Write(std::string_view text);
+
+        void WriteInt(int value);
+
+        // Формат совпадает с выводом double в std::ostream по умолчанию (%g, 6 значащих цифр)
+        void WriteDouble(double value);
+
+        void WriteBool(bool value);
+
+        // Записывает строковый литерал в кавычках, экранируя специальные символы
+        void WriteString(std::string_view value);
+
+        // Записывает часть содержимого строкового литерала, без кавычек. Позволяет выводить
+        // длинную строку по частям, не собирая её целиком
+        void WriteEscaped(std::string_view text);
+
+        void WriteNode(const Node &node);
+
+        // Потоковый вывод значений без построения Node. Разделители и пробелы расставляются так же,
+        // как при печати Dict и Array. Ключи словаря нужно передавать по возрастанию: в этом
+        // порядке их печатает Json::Dict
+        Writer &StartDict();
+
+        Writer &Key(std::string_view key);
+
+        Writer &EndDict();
+
+        Writer &StartArray();
+
+        Writer &EndArray();
+
+        Writer &Value(std::nullptr_t);
+
+        Writer &Value(int value);
+
+        Writer &Value(double value);
+
+        Writer &Value(bool value);
+
+        Writer &Value(std::string_view value);
+
+        Writer &Value(const char *value);
+
+        // Записывает готовый текст значения как есть, расставив разделители
+        Writer &RawValue(std::string_view json);
+
+        void Flush();
+
+    private:
+        static constexpr size_t CAPACITY = 1 << 16;
+
+        // Ставит разделитель перед очередным элементом открытого контейнера
+        void BeforeValue();
+
+        std::ostream &output_;
+        std::unique_ptr<char[]> buffer_;
+        size_t size_ = 0;
+        std::vector<bool> first_in_container_;
+        bool after_key_ = false;
+    };
+
+    // Буфер потока, передающий весь выведенный текст в writer через WriteEscaped. Через
+    // std::ostream с таким буфером можно печатать содержимое строкового литерала прямо в ответ
+    class EscapingBuf : public std::streambuf {
+    public:
+        explicit EscapingBuf(Writer &writer)
+                : writer_(writer) {
+        }
+
+    protected:
+        std::streamsize xsputn(const char *s, std::streamsize count) override;
+
+        int_type overflow(int_type c) override;
+
+    private:
+        Writer &writer_;
+    };
+
     struct ContainerPrinter {
-        std::ostream &out;
+        Writer &out;
 
         void operator()(std::nullptr_t);
 
-        void operator()(const std::string &value);
+        void operator()(const String &value);
 
         void operator()(int value);
 
@@ -111,7 +289,7 @@ namespace Json {
 
         void operator()(bool value);
 
-        void operator()(Array array);
+        void operator()(const Array &array);
 
         void operator()(const Dict& dict);
     };
@@ -138,8 +138,8 @@ namespace Json {
         if (std::holds_alternative<double>(value)) {
             return {std::get<double>(value)};
         }
-        if (std::holds_alternative<std::string>(value)) {
-            return {std::get<std::string>(value)};
+        if (std::holds_alternative<String>(value)) {
+            return {std::get<String>(value)};
         }
         if (std::holds_alternative<std::nullptr_t>(value)) {
             return {std::get<std::nullptr_t>(value)};
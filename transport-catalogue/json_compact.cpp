@@ -0,0 +1,337 @@
+#include "json_compact.h"
+#include "json_scanner.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+namespace Json::Compact {
+
+    static_assert(sizeof(Value) == 16);
+
+    namespace {
+
+        // Число ключей, до которого линейный просмотр быстрее двоичного поиска
+        constexpr uint32_t LINEAR_SEARCH_LIMIT = 8;
+
+        class Parser : private Detail::Scanner {
+        public:
+            Parser(std::string_view text, std::pmr::memory_resource *resource)
+                    : Scanner(text), resource_(resource) {
+            }
+
+            Value LoadValue();
+
+        private:
+            std::string_view LoadString();
+
+            Value LoadNumber();
+
+            Value LoadArray();
+
+            Value LoadDict();
+
+            // Переносит хвост рабочего стека, начиная с begin, в память resource_
+            template<typename T>
+            const T *Commit(std::vector<T> &stack, size_t begin);
+
+            std::pmr::memory_resource *resource_;
+            // Элементы ещё не закрытых массивов и словарей: размер контейнера становится
+            // известен только в конце, и лишь тогда он целиком копируется в resource_
+            std::vector<Value> values_;
+            std::vector<Member> members_;
+            std::string unescaped_;
+        };
+
+        template<typename T>
+        const T *Parser::Commit(std::vector<T> &stack, size_t begin) {
+            const size_t count = stack.size() - begin;
+            if (count == 0) {
+                return nullptr;
+            }
+            auto *result = static_cast<T *>(resource_->allocate(count * sizeof(T), alignof(T)));
+            std::uninitialized_copy(stack.begin() + static_cast<std::ptrdiff_t>(begin), stack.end(), result);
+            stack.resize(begin);
+            return result;
+        }
+
+        // Считывает строковый литерал после открывающей кавычки. Если escape-последовательностей нет,
+        // результат указывает во входной буфер
+        std::string_view Parser::LoadString() {
+            const char *begin = pos_;
+            pos_ = ScanStringRun();
+            if (pos_ != end_ && *pos_ == '"') {
+                return {begin, static_cast<size_t>(pos_++ - begin)};
+            }
+
+            unescaped_.assign(begin, pos_);
+            while (true) {
+                if (pos_ == end_) {
+                    throw ParsingError("String parsing error");
+                }
+                const char ch = *pos_++;
+                if (ch == '"') {
+                    break;
+                } else if (ch == '\\') {
+                    AppendEscape(unescaped_);
+                } else {
+                    throw ParsingError("Unexpected end of line"s);
+                }
+                const char *special = ScanStringRun();
+                unescaped_.append(pos_, special);
+                pos_ = special;
+            }
+
+            auto *result = static_cast<char *>(resource_->allocate(unescaped_.size(), 1));
+            std::memcpy(result, unescaped_.data(), unescaped_.size());
+            return {result, unescaped_.size()};
+        }
+
+        Value Parser::LoadNumber() {
+            const auto [begin, end, is_int] = ScanNumber();
+            if (is_int) {
+                int value = 0;
+                if (auto [ptr, ec] = std::from_chars(begin, end, value); ec == std::errc() && ptr == end) {
+                    return Value(value);
+                }
+            }
+            double value = 0.0;
+            if (auto [ptr, ec] = std::from_chars(begin, end, value); ec == std::errc() && ptr == end) {
+                return Value(value);
+            }
+            throw ParsingError("Failed to convert "s + std::string(begin, end) + " to number"s);
+        }
+
+        Value Parser::LoadArray() {
+            const size_t begin = values_.size();
+            if (NextToken() == ']') {
+                ++pos_;
+                return Value(ArrayView{});
+            }
+
+            while (true) {
+                Value item = LoadValue();
+                values_.push_back(item);
+                const char c = NextToken();
+                ++pos_;
+                if (c == ']') {
+                    break;
+                } else if (c != ',') {
+                    throw ParsingError("Array error");
+                }
+            }
+
+            const size_t count = values_.size() - begin;
+            return Value(ArrayView(Commit(values_, begin), count));
+        }
+
+        Value Parser::LoadDict() {
+            const size_t begin = members_.size();
+            if (NextToken() == '}') {
+                ++pos_;
+                return Value(Object{});
+            }
+
+            while (true) {
+                if (NextToken() != '"') {
+                    throw ParsingError("Dict key expected");
+                }
+                ++pos_;
+                const std::string_view key = LoadString();
+                if (NextToken() != ':') {
+                    throw ParsingError("Dict error");
+                }
+                ++pos_;
+                Value value = LoadValue();
+                members_.push_back({key, value});
+
+                const char c = NextToken();
+                ++pos_;
+                if (c == '}') {
+                    break;
+                } else if (c != ',') {
+                    throw ParsingError("Dict error");
+                }
+            }
+
+            // Устойчивая сортировка: при повторе ключа, как и в Json::Dict, находится первое значение
+            const auto first = members_.begin() + static_cast<std::ptrdiff_t>(begin);
+            std::stable_sort(first, members_.end(), [](const Member &lhs, const Member &rhs) {
+                return lhs.key < rhs.key;
+            });
+            const auto count = static_cast<uint32_t>(members_.size() - begin);
+            return Value(Object(Commit(members_, begin), count));
+        }
+
+        Value Parser::LoadValue() {
+            const char c = NextToken();
+
+            if (c == 'n') {
+                ExpectKeyword("null"sv);
+                return Value{};
+            } else if (c == '"') {
+                ++pos_;
+                return Value(LoadString());
+            } else if (c == 't') {
+                ExpectKeyword("true"sv);
+                return Value(true);
+            } else if (c == 'f') {
+                ExpectKeyword("false"sv);
+                return Value(false);
+            } else if (c == '[') {
+                ++pos_;
+                return LoadArray();
+            } else if (c == '{') {
+                ++pos_;
+                return LoadDict();
+            } else {
+                return LoadNumber();
+            }
+        }
+
+    }  // namespace
+
+    Value::Value(bool value)
+            : boolean_(value), type_(Type::BOOL) {
+    }
+
+    Value::Value(int value)
+            : integer_(value), type_(Type::INT) {
+    }
+
+    Value::Value(double value)
+            : real_(value), type_(Type::DOUBLE) {
+    }
+
+    Value::Value(std::string_view value)
+            : string_(value.data()), size_(static_cast<uint32_t>(value.size())), type_(Type::STRING) {
+    }
+
+    Value::Value(ArrayView items)
+            : items_(items.data()), size_(static_cast<uint32_t>(items.size())), type_(Type::ARRAY) {
+    }
+
+    Value::Value(const Object &object)
+            : members_(object.begin()), size_(static_cast<uint32_t>(object.size())), type_(Type::DICT) {
+    }
+
+    Value::Type Value::GetType() const {
+        return type_;
+    }
+
+    bool Value::IsNull() const {
+        return type_ == Type::NUL;
+    }
+
+    bool Value::IsBool() const {
+        return type_ == Type::BOOL;
+    }
+
+    bool Value::IsInt() const {
+        return type_ == Type::INT;
+    }
+
+    bool Value::IsDouble() const {
+        return type_ == Type::DOUBLE || type_ == Type::INT;
+    }
+
+    bool Value::IsNativeDouble() const {
+        return type_ == Type::DOUBLE;
+    }
+
+    bool Value::IsString() const {
+        return type_ == Type::STRING;
+    }
+
+    bool Value::IsArray() const {
+        return type_ == Type::ARRAY;
+    }
+
+    bool Value::IsDict() const {
+        return type_ == Type::DICT;
+    }
+
+    int Value::AsInt() const {
+        if (!IsInt()) throw std::logic_error("wrong type");
+        return integer_;
+    }
+
+    bool Value::AsBool() const {
+        if (!IsBool()) throw std::logic_error("wrong type");
+        return boolean_;
+    }
+
+    double Value::AsDouble() const {
+        if (!IsDouble()) throw std::logic_error("wrong type");
+        if (IsInt()) return static_cast<double>(integer_);
+        return real_;
+    }
+
+    std::string_view Value::AsString() const {
+        if (!IsString()) throw std::logic_error("wrong type");
+        return {string_, size_};
+    }
+
+    ArrayView Value::AsArray() const {
+        if (!IsArray()) throw std::logic_error("wrong type");
+        return {items_, size_};
+    }
+
+    Object Value::AsDict() const {
+        if (!IsDict()) throw std::logic_error("Not a dict"s);
+        return {members_, size_};
+    }
+
+    Object::Object(const Member *members, uint32_t size)
+            : members_(members), size_(size) {
+    }
+
+    const Member *Object::begin() const {
+        return members_;
+    }
+
+    const Member *Object::end() const {
+        return members_ + size_;
+    }
+
+    size_t Object::size() const {
+        return size_;
+    }
+
+    const Value *Object::Find(std::string_view key) const {
+        if (size_ <= LINEAR_SEARCH_LIMIT) {
+            for (const Member &member: *this) {
+                if (member.key == key) {
+                    return &member.value;
+                }
+            }
+            return nullptr;
+        }
+        const Member *it = std::lower_bound(begin(), end(), key, [](const Member &member, std::string_view key) {
+            return member.key < key;
+        });
+        return it != end() && it->key == key ? &it->value : nullptr;
+    }
+
+    const Value &Object::at(std::string_view key) const {
+        const Value *value = Find(key);
+        if (!value) {
+            throw std::out_of_range("No key "s + std::string(key));
+        }
+        return *value;
+    }
+
+    size_t Object::count(std::string_view key) const {
+        return Find(key) ? 1 : 0;
+    }
+
+    Value Load(std::string_view text, std::pmr::memory_resource *resource) {
+        return Parser(text, resource).LoadValue();
+    }
+
+}
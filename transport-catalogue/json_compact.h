@@ -0,0 +1,122 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+
+// Компактное представление JSON-документа только для чтения. В отличие от Json::Node здесь нет
+// std::map и std::string: узел занимает 16 байт, словарь хранится отсортированным массивом пар,
+// а строки без escape-последовательностей указывают прямо во входной буфер
+namespace Json::Compact {
+
+    class Value;
+
+    struct Member;
+
+    class Object;
+
+    using ArrayView = std::span<const Value>;
+
+    class Value {
+    public:
+        enum class Type : uint8_t {
+            NUL, BOOL, INT, DOUBLE, STRING, ARRAY, DICT
+        };
+
+        Value() = default;
+
+        explicit Value(bool value);
+
+        explicit Value(int value);
+
+        explicit Value(double value);
+
+        explicit Value(std::string_view value);
+
+        explicit Value(ArrayView items);
+
+        explicit Value(const Object &object);
+
+        [[nodiscard]] Type GetType() const;
+
+        [[nodiscard]] bool IsNull() const;
+
+        [[nodiscard]] bool IsBool() const;
+
+        [[nodiscard]] bool IsInt() const;
+
+        [[nodiscard]] bool IsDouble() const;
+
+        [[nodiscard]] bool IsNativeDouble() const;
+
+        [[nodiscard]] bool IsString() const;
+
+        [[nodiscard]] bool IsArray() const;
+
+        [[nodiscard]] bool IsDict() const;
+
+        [[nodiscard]] int AsInt() const;
+
+        [[nodiscard]] bool AsBool() const;
+
+        [[nodiscard]] double AsDouble() const;
+
+        [[nodiscard]] std::string_view AsString() const;
+
+        [[nodiscard]] ArrayView AsArray() const;
+
+        [[nodiscard]] Object AsDict() const;
+
+    private:
+        union {
+            bool boolean_;
+            int integer_;
+            double real_;
+            const char *string_ = nullptr;
+            const Value *items_;
+            const Member *members_;
+        };
+        uint32_t size_ = 0;
+        Type type_ = Type::NUL;
+    };
+
+    struct Member {
+        std::string_view key;
+        Value value;
+    };
+
+    // Словарь из отсортированных по ключу пар. В запросах обычно 3-5 ключей,
+    // поэтому небольшие словари просматриваются линейно
+    class Object {
+    public:
+        Object() = default;
+
+        Object(const Member *members, uint32_t size);
+
+        [[nodiscard]] const Member *begin() const;
+
+        [[nodiscard]] const Member *end() const;
+
+        [[nodiscard]] size_t size() const;
+
+        // Возвращает nullptr, если ключа нет
+        [[nodiscard]] const Value *Find(std::string_view key) const;
+
+        // Как и std::map::at, бросает std::out_of_range при отсутствии ключа
+        [[nodiscard]] const Value &at(std::string_view key) const;
+
+        [[nodiscard]] size_t count(std::string_view key) const;
+
+    private:
+        const Member *members_ = nullptr;
+        uint32_t size_ = 0;
+    };
+
+    // Разбирает text. Массивы, словари и строки с escape-последовательностями размещаются в resource,
+    // остальные строки ссылаются на text: результат действителен, пока живы оба
+    Value Load(std::string_view text, std::pmr::memory_resource *resource);
+
+}
@@ -1,17 +1,188 @@
 #include "json_reader.h"
-#include "json_builder.h"
+#include "parallel.h"
+
+namespace {
+
+    // Объём текста запросов, декодируемых за один параллельный проход
+    constexpr size_t BATCH_BYTES = 4 << 20;
+    // Маршрутов или остановок, ответы на которые готовит один поток
+    constexpr size_t FRAGMENTS_PER_BLOCK = 256;
+
+    // Тела ответов пишутся одним кодом и при ответе, и при подготовке фрагментов.
+    // write_id пишет значение request_id
+    template<typename WriteId>
+    void WriteBusStat(const TCatalogue::BusRouteInfo &stat, Json::Writer &writer, WriteId write_id) {
+        writer.StartDict()
+                .Key("curvature").Value(stat.curvature)
+                .Key("request_id");
+        write_id();
+        writer.Key("route_length").Value(stat.road_lenght)
+                .Key("stop_count").Value(stat.stops_count)
+                .Key("unique_stop_count").Value(stat.unique_stops)
+                .EndDict();
+    }
+
+    template<typename WriteId>
+    void WriteStopBuses(const std::set<std::string> &buses, Json::Writer &writer, WriteId write_id) {
+        writer.StartDict().Key("buses").StartArray();
+        for (auto &bus: buses) {
+            writer.Value(bus);
+        }
+        writer.EndArray().Key("request_id");
+        write_id();
+        writer.EndDict();
+    }
+
+    // Пишет тело ответа без значения request_id и запоминает место, куда его вставить
+    template<typename WriteBody>
+    TCatalogue::ResponseFragments::Fragment MakeFragment(WriteBody write_body) {
+        std::ostringstream stream;
+        uint32_t split = 0;
+        {
+            Json::Writer writer(stream);
+            write_body(writer, [&] {
+                writer.Flush();
+                split = static_cast<uint32_t>(stream.tellp());
+                writer.RawValue({});
+            });
+        }
+        return {std::move(stream).str(), split};
+    }
+
+    void WriteFragment(const TCatalogue::ResponseFragments::Fragment &fragment, int id, Json::Writer &writer) {
+        writer.RawValue(fragment.Head());
+        writer.WriteInt(id);
+        writer.Write(fragment.Tail());
+    }
+
+    // Декодирует пачку запросов на всех ядрах. decoded[i] == 0, если запрос не подошёл под схему
+    template<typename Request>
+    void DecodeBatch(const std::vector<std::string_view> &texts, std::vector<Request> &requests,
+                     std::vector<char> &decoded, bool (*decode)(std::string_view, Request &)) {
+        if (requests.size() < texts.size()) {
+            requests.resize(texts.size());
+        }
+        decoded.assign(texts.size(), 0);
+        Parallel::ForEachRange(texts.size(), 64, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                decoded[i] = decode(texts[i], requests[i]);
+            }
+        });
+    }
+
+}
 
-void JsonReader::ReadJson(const Json::Node &requests, RequestHandler &rh) const {
-    Json::Array result;
+void JsonReader::ReadJson(const Json::Node &requests, RequestHandler &rh, std::ostream &output) const {
+    Json::Writer writer(output);
+    writer.StartArray();
     for (auto &request: requests.AsArray()) {
-        const auto &request_map = request.AsDict();
-        const auto &type = request_map.at("type").AsString();
-        if (type == "Stop") result.emplace_back(OutStop(request_map, rh).AsDict());
-        if (type == "Bus") result.emplace_back(OutRoute(request_map, rh).AsDict());
-        if (type == "Map") result.emplace_back(OutMap(request_map, rh).AsDict());
-        if (type == "Route") result.emplace_back(OutRouting(request_map, rh).AsDict());
+        OutRequest(request.AsDict(), rh, writer);
+    }
+    writer.EndArray();
+}
+
+JsonReader JsonReader::ReadUntilStatRequests(Json::Reader &reader) {
+    Json::Dict sections;
+    reader.BeginDict();
+    for (std::string key; reader.NextKey(key);) {
+        if (key == "stat_requests" && sections.count("serialization_settings")) {
+            JsonReader result(Json::Document{std::move(sections)});
+            result.stat_requests_in_stream_ = true;
+            return result;
+        }
+        sections.insert_or_assign(Json::String(key), reader.ReadNode());
+    }
+    return JsonReader(Json::Document{std::move(sections)});
+}
+
+void JsonReader::ReadJson(Json::Reader &reader, RequestHandler &rh, std::ostream &output) const {
+    if (!stat_requests_in_stream_) {
+        ReadJson(ProcessStatRequests(), rh, output);
+        return;
+    }
+
+    Json::Writer writer(output);
+    writer.StartArray();
+    std::vector<std::string_view> texts;
+    std::vector<Json::Schema::StatRequest> requests;
+    std::vector<char> decoded;
+    // Запросы, не подошедшие под схему, разбираются в компактное представление поверх буфера
+    // Reader; узлы нужны только до построения ответа, поэтому арена сбрасывается после каждого
+    Json::Arena arena;
+    reader.BeginArray();
+    for (bool more = true; more;) {
+        more = reader.NextItems(texts, BATCH_BYTES);
+        DecodeBatch(texts, requests, decoded, Json::Schema::DecodeStatRequest);
+        for (size_t i = 0; i < texts.size(); ++i) {
+            if (decoded[i]) {
+                OutRequest(requests[i], rh, writer);
+            } else {
+                OutRequest(Json::Compact::Load(texts[i], &arena).AsDict(), rh, writer);
+                arena.release();
+            }
+        }
+    }
+    writer.EndArray();
+}
+
+void JsonReader::ReadBatch(std::string_view batch, RequestHandler &rh, std::ostream &output) {
+    Json::Arena arena;
+    const Json::Compact::Value root = Json::Compact::Load(batch, &arena);
+    const Json::Compact::ArrayView requests = root.IsDict() ? root.AsDict().at("stat_requests").AsArray()
+                                                            : root.AsArray();
+    Json::Writer writer(output);
+    writer.StartArray();
+    for (const auto &request: requests) {
+        OutRequest(request.AsDict(), rh, writer);
+    }
+    writer.EndArray();
+}
+
+template<typename Request>
+void JsonReader::OutRequest(const Request &request_map, RequestHandler &rh, Json::Writer &writer) {
+    using Type = Json::Schema::StatRequest::Type;
+    Json::Schema::StatRequest request;
+    const auto &type = request_map.at("type").AsString();
+    if (type == "Stop") request.type = Type::STOP;
+    else if (type == "Bus") request.type = Type::BUS;
+    else if (type == "Map") request.type = Type::MAP;
+    else if (type == "Route") request.type = Type::ROUTE;
+    else if (type == "Search") request.type = Type::SEARCH;
+    else return;
+
+    request.id = request_map.at("id").AsInt();
+    if (request.type == Type::STOP || request.type == Type::BUS) {
+        request.name = request_map.at("name").AsString();
+    } else if (request.type == Type::ROUTE) {
+        request.from = request_map.at("from").AsString();
+        request.to = request_map.at("to").AsString();
+    } else if (request.type == Type::SEARCH) {
+        request.prefix = request_map.at("prefix").AsString();
+        if (request_map.count("limit")) {
+            request.limit = request_map.at("limit").AsInt();
+        }
+    }
+    OutRequest(request, rh, writer);
+}
+
+void JsonReader::OutRequest(const Json::Schema::StatRequest &request, RequestHandler &rh, Json::Writer &writer) {
+    switch (request.type) {
+        case Json::Schema::StatRequest::Type::STOP:
+            OutStop(request, rh, writer);
+            break;
+        case Json::Schema::StatRequest::Type::BUS:
+            OutRoute(request, rh, writer);
+            break;
+        case Json::Schema::StatRequest::Type::MAP:
+            OutMap(request, rh, writer);
+            break;
+        case Json::Schema::StatRequest::Type::ROUTE:
+            OutRouting(request, rh, writer);
+            break;
+        case Json::Schema::StatRequest::Type::SEARCH:
+            OutSearch(request, rh, writer);
+            break;
     }
-    Json::Print(Json::Document{result}, std::cout);
 }
 
 const Json::Node &JsonReader::ProcessBaseRequests() const {
@@ -44,69 +215,157 @@ const Json::Node &JsonReader::ProcessRoutingSettings() const {
 }
 
 
-void JsonReader::FillCatalogue(TCatalogue::TransportCatalogue &TCatalogue) {
-    const Json::Array &arr = ProcessBaseRequests().AsArray();
-    for (auto &request_stops: arr) {
+void JsonReader::FillCatalogue(TCatalogue::TransportCatalogue &TCatalogue, TCatalogue::CatalogueChanges *changes) {
+    PendingRequests pending;
 
-        const auto &stops = request_stops.AsDict();
-        const auto &type = stops.at("type").AsString();
+    Json::Schema::BaseRequest base_request;
+    for (auto &request: ProcessBaseRequests().AsArray()) {
+        if (ToBaseRequest(request.AsDict(), base_request)) {
+            ProcessBaseRequest(base_request, TCatalogue, pending, changes);
+        }
+    }
+
+    ProcessPending(pending, TCatalogue);
+}
 
-        if (type == "Stop") {
-            auto [stop_name, coordinates, stop_distances] = ProcessStop(stops);
-            TCatalogue.AddStop(stop_name, coordinates);
+JsonReader JsonReader::ReadBase(std::istream &input, TCatalogue::TransportCatalogue &catalogue,
+                                TCatalogue::CatalogueChanges *changes) {
+    Json::Reader reader(input);
+    Json::Dict settings;
+    PendingRequests pending;
+    std::vector<std::string_view> texts;
+    std::vector<Json::Schema::BaseRequest> requests;
+    std::vector<char> decoded;
+
+    reader.BeginDict();
+    for (std::string key; reader.NextKey(key);) {
+        if (key != "base_requests") {
+            settings.insert_or_assign(Json::String(key), reader.ReadNode());
+            continue;
+        }
+        // Запросы декодируются пачками параллельно, а в справочник добавляются по порядку.
+        // Тексты пачки действительны только до следующего обращения к reader
+        reader.BeginArray();
+        for (bool more = true; more;) {
+            more = reader.NextItems(texts, BATCH_BYTES);
+            DecodeBatch(texts, requests, decoded, Json::Schema::DecodeBaseRequest);
+            for (size_t i = 0; i < texts.size(); ++i) {
+                if (decoded[i]) {
+                    ProcessBaseRequest(requests[i], catalogue, pending, changes);
+                    continue;
+                }
+                const Json::Document document = Json::Load(texts[i]);
+                if (ToBaseRequest(document.GetRoot().AsDict(), requests[i])) {
+                    ProcessBaseRequest(requests[i], catalogue, pending, changes);
+                }
+            }
         }
     }
 
-    ProcessDistances(TCatalogue);
+    ProcessPending(pending, catalogue);
+    return JsonReader(Json::Document{std::move(settings)});
+}
 
-    for (auto &request_bus: arr) {
-        const auto &request_bus_map = request_bus.AsDict();
-        const auto &type = request_bus_map.at("type").AsString();
-        if (type == "Bus") {
-            auto [bus_number, stops, isLoop] = ProcessBus(request_bus_map, TCatalogue);
-            TCatalogue.AddBus(bus_number, stops, isLoop);
+bool JsonReader::ToBaseRequest(const Json::Dict &request_map, Json::Schema::BaseRequest &request) {
+    using Type = Json::Schema::BaseRequest::Type;
+    const auto &type = request_map.at("type").AsString();
+    if (type == "Stop") request.type = Type::STOP;
+    else if (type == "Bus") request.type = Type::BUS;
+    else return false;
+
+    request.name = request_map.at("name").AsString();
+    request.road_distances.clear();
+    request.stops.clear();
+    if (request.type == Type::STOP) {
+        request.latitude = request_map.at("latitude").AsDouble();
+        request.longitude = request_map.at("longitude").AsDouble();
+        for (const auto &[to_name, dist]: request_map.at("road_distances").AsDict()) {
+            request.road_distances.emplace_back(to_name, dist.AsInt());
+        }
+    } else {
+        for (const auto &stop: request_map.at("stops").AsArray()) {
+            request.stops.emplace_back(stop.AsString());
         }
+        request.is_roundtrip = request_map.at("is_roundtrip").AsBool();
     }
+    return true;
 }
 
-std::tuple<std::string_view, Geo::Coordinates, std::map<std::string_view, int>>
-JsonReader::ProcessStop(const Json::Dict &request_map) {
-    std::string_view stop_name = request_map.at("name").AsString();
-    Geo::Coordinates coordinates = {request_map.at("latitude").AsDouble(), request_map.at("longitude").AsDouble()};
-    std::map<std::string_view, int> stopDistances;
-    auto &distances = request_map.at("road_distances").AsDict();
-    for (auto &[stop, dist]: distances) {
-        stopDistances.emplace(stop, dist.AsInt());
+uint32_t JsonReader::StopRefs::Intern(std::string_view name, const TCatalogue::TransportCatalogue &catalogue) {
+    if (const auto it = ids_.find(name); it != ids_.end()) {
+        return it->second;
     }
-    return {stop_name, coordinates, stopDistances};
+    const TCatalogue::Stop *stop = catalogue.FindStop(name);
+    const std::string_view key = stop ? std::string_view(stop->name) : std::string_view(copies_.emplace_back(name));
+    const auto id = static_cast<uint32_t>(names_.size());
+    ids_.emplace(key, id);
+    names_.push_back(key);
+    stops_.push_back(stop);
+    return id;
 }
 
-void JsonReader::ProcessDistances(TCatalogue::TransportCatalogue &TCatalogue) const {
-    const Json::Array &array = ProcessBaseRequests().AsArray();
-    for (auto &stops: array) {
-        const auto &stopsMap = stops.AsDict();
-        const auto &type = stopsMap.at("type").AsString();
-        if (type == "Stop") {
-            auto [stop_name, coordinates, stopDistances] = ProcessStop(stopsMap);
-            for (auto &[to_name, dist]: stopDistances) {
-                auto from = TCatalogue.FindStop(stop_name);
-                auto to = TCatalogue.FindStop(to_name);
-                TCatalogue.SetDistanseToTwoStops(from, to, dist);
-            }
+std::vector<const TCatalogue::Stop *> JsonReader::StopRefs::Resolve(
+        const TCatalogue::TransportCatalogue &catalogue) const {
+    std::vector<const TCatalogue::Stop *> result = stops_;
+    for (size_t i = 0; i < result.size(); ++i) {
+        if (!result[i]) {
+            result[i] = catalogue.FindStop(names_[i]);
         }
     }
+    return result;
 }
 
-std::tuple<std::string_view, std::vector<std::string>, bool>
-JsonReader::ProcessBus(const Json::Dict &request_map, TCatalogue::TransportCatalogue &catalogue) {
-    std::string_view bus_number = request_map.at("name").AsString();
-    std::vector<std::string> stops;
-    for (auto &stop: request_map.at("stops").AsArray()) {
-        stops.push_back(catalogue.FindStop(stop.AsString())->name);
+void JsonReader::ProcessBaseRequest(const Json::Schema::BaseRequest &request,
+                                    TCatalogue::TransportCatalogue &catalogue,
+                                    PendingRequests &pending, TCatalogue::CatalogueChanges *changes) {
+    if (request.type == Json::Schema::BaseRequest::Type::STOP) {
+        ProcessStop(request, catalogue, pending, changes);
+    } else {
+        if (changes) {
+            changes->buses.emplace(request.name);
+        }
+        PendingBus &bus = pending.buses.emplace_back();
+        bus.name = request.name;
+        bus.stops.reserve(request.stops.size());
+        for (const auto &stop: request.stops) {
+            bus.stops.push_back(pending.stops.Intern(stop, catalogue));
+        }
+        bus.is_loop = request.is_roundtrip;
     }
-    bool is_loop = request_map.at("is_roundtrip").AsBool();
+}
 
-    return std::make_tuple(bus_number, stops, is_loop);
+void JsonReader::ProcessStop(const Json::Schema::BaseRequest &request, TCatalogue::TransportCatalogue &catalogue,
+                             PendingRequests &pending, TCatalogue::CatalogueChanges *changes) {
+    const TCatalogue::Stop *stop = catalogue.AddStop(request.name, {request.latitude, request.longitude});
+    if (changes) {
+        changes->stops.emplace(request.name);
+    }
+    for (const auto &[to_name, dist]: request.road_distances) {
+        if (changes) {
+            changes->stops.emplace(to_name);
+        }
+        if (const TCatalogue::Stop *to = catalogue.FindStop(to_name)) {
+            catalogue.SetDistanseToTwoStops(stop, to, dist);
+        } else {
+            pending.distances.push_back({stop, pending.stops.Intern(to_name, catalogue), dist});
+        }
+    }
+}
+
+void JsonReader::ProcessPending(const PendingRequests &pending, TCatalogue::TransportCatalogue &catalogue) {
+    const std::vector<const TCatalogue::Stop *> stops = pending.stops.Resolve(catalogue);
+    for (const auto &[from, to, dist]: pending.distances) {
+        catalogue.SetDistanseToTwoStops(from, stops[to], dist);
+    }
+
+    for (const auto &bus: pending.buses) {
+        std::vector<const TCatalogue::Stop *> bus_stops;
+        bus_stops.reserve(bus.stops.size());
+        for (const uint32_t id: bus.stops) {
+            bus_stops.push_back(stops[id]);
+        }
+        catalogue.AddBus(bus.name, std::move(bus_stops), bus.is_loop);
+    }
 }
 
 TRouting::TRouter JsonReader::FillRouting(const Json::Node &requests) {
@@ -115,110 +374,153 @@ TRouting::TRouter JsonReader::FillRouting(const Json::Node &requests) {
                              requests.AsDict().at("bus_velocity").AsDouble()};
 }
 
-Json::Node JsonReader::OutMap(const Json::Dict &request_map, RequestHandler &rh) {
-    Json::Dict result;
-    result["request_id"] = request_map.at("id").AsInt();
-    std::ostringstream stream;
-    Svg::Document map = rh.RenderMap();
-    map.Render(stream);
-    result["map"] = stream.str();
-
-    return Json::Node{result};
+// Ключи ответов выводятся в алфавитном порядке, как их напечатал бы Json::Dict
+void JsonReader::OutMap(const Json::Schema::StatRequest &request, RequestHandler &rh, Json::Writer &writer) {
+    writer.StartDict()
+            .Key("map").RawValue(rh.RenderMapJson())
+            .Key("request_id").Value(request.id)
+            .EndDict();
 }
 
-Json::Node JsonReader::OutRoute(const Json::Dict &request_map, RequestHandler &rh) {
-    Json::Dict result;
-    const std::string &route_number = request_map.at("name").AsString();
-    result["request_id"] = request_map.at("id").AsInt();
-    if (!rh.IsBusNumber(route_number)) {
-        result["error_message"] = Json::Node{static_cast<std::string>("not found")};
-    } else {
-        result["curvature"] = rh.GetBusStat(route_number)->curvature;
-        result["route_length"] = rh.GetBusStat(route_number)->road_lenght;
-        result["stop_count"] = static_cast<int>(rh.GetBusStat(route_number)->stops_count);
-        result["unique_stop_count"] = static_cast<int>(rh.GetBusStat(route_number)->unique_stops);
+void JsonReader::OutRoute(const Json::Schema::StatRequest &request, RequestHandler &rh, Json::Writer &writer) {
+    const int id = request.id;
+    if (const auto *fragment = rh.FindBusResponse(request.name)) {
+        WriteFragment(*fragment, id, writer);
+        return;
     }
-
-    return Json::Node{result};
+    if (!rh.IsBusNumber(request.name)) {
+        WriteErrorMessage(id, "not found", writer);
+        return;
+    }
+    WriteBusStat(*rh.GetBusStat(request.name), writer, [&] { writer.Value(id); });
 }
 
-Json::Node JsonReader::OutStop(const Json::Dict &request_map, RequestHandler &rh) {
-    Json::Dict result;
-    const std::string &stop_name = request_map.at("name").AsString();
-    result["request_id"] = request_map.at("id").AsInt();
+void JsonReader::OutStop(const Json::Schema::StatRequest &request, RequestHandler &rh, Json::Writer &writer) {
+    const std::string_view stop_name = request.name;
+    const int id = request.id;
+    if (const auto *fragment = rh.FindStopResponse(stop_name)) {
+        WriteFragment(*fragment, id, writer);
+        return;
+    }
     if (!rh.IsStopName(stop_name)) {
-        result["error_message"] = Json::Node{static_cast<std::string>("not found")};
-    } else {
-        Json::Array buses;
-        for (auto &bus: rh.GetBusesByStop(stop_name)) {
-            buses.emplace_back(bus);
+        WriteErrorMessage(id, "not found", writer);
+        return;
+    }
+    WriteStopBuses(rh.GetBusesByStop(stop_name), writer, [&] { writer.Value(id); });
+}
+
+TCatalogue::ResponseFragments JsonReader::MakeResponseFragments(const TCatalogue::TransportCatalogue &catalogue) {
+    const auto all_stops = catalogue.ReturnAllStops();
+    const auto all_buses = catalogue.ReturnAllBus();
+    std::vector<const TCatalogue::Stop *> stops;
+    stops.reserve(all_stops.size());
+    for (const auto &[name, stop]: all_stops) {
+        stops.push_back(stop);
+    }
+    std::vector<const TCatalogue::Bus *> buses;
+    buses.reserve(all_buses.size());
+    for (const auto &[name, bus]: all_buses) {
+        buses.push_back(bus);
+    }
+
+    // Сначала все остановки, затем все маршруты
+    std::vector<TCatalogue::ResponseFragments::Fragment> fragments(stops.size() + buses.size());
+    Parallel::ForEachRange(fragments.size(), FRAGMENTS_PER_BLOCK, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (i < stops.size()) {
+                const auto buses_on_stop = catalogue.GetBusesOnStop(stops[i]->name);
+                fragments[i] = MakeFragment([&](Json::Writer &writer, auto write_id) {
+                    WriteStopBuses(buses_on_stop, writer, write_id);
+                });
+            } else {
+                const auto stat = catalogue.GetRouteInfo(buses[i - stops.size()]->name);
+                fragments[i] = MakeFragment([&](Json::Writer &writer, auto write_id) {
+                    WriteBusStat(stat, writer, write_id);
+                });
+            }
         }
-        result["buses"] = buses;
+    });
+
+    TCatalogue::ResponseFragments result;
+    for (size_t i = 0; i < stops.size(); ++i) {
+        result.AddStop(stops[i]->name, std::move(fragments[i]));
+    }
+    for (size_t i = 0; i < buses.size(); ++i) {
+        result.AddBus(buses[i]->name, std::move(fragments[stops.size() + i]));
     }
+    return result;
+}
 
-    return Json::Node{result};
+bool JsonReader::PrecomputeResponses(const Json::Dict &serialization_settings) {
+    const auto it = serialization_settings.find("precompute_responses");
+    return it != serialization_settings.end() && it->second.AsBool();
 }
 
-Json::Node JsonReader::OutRouting(const Json::Dict &request_map, RequestHandler &rh) {
-    const int id = request_map.at("id").AsInt();
-    const std::string_view stop_from = request_map.at("from").AsString();
-    const std::string_view stop_to = request_map.at("to").AsString();
-    const auto &routing = rh.FetchRoute(stop_from, stop_to);
+bool JsonReader::PrecomputeMap(const Json::Dict &serialization_settings) {
+    const auto it = serialization_settings.find("precompute_map");
+    return it != serialization_settings.end() && it->second.AsBool();
+}
+
+void JsonReader::OutRouting(const Json::Schema::StatRequest &request, RequestHandler &rh, Json::Writer &writer) {
+    const int id = request.id;
+    const auto &routing = rh.FetchRoute(request.from, request.to);
 
     if (!routing) {
-        return CreateRouteErrorMessageNode(id, "not found");
+        WriteErrorMessage(id, "not found", writer);
+        return;
     }
 
-    Json::Array items;
     double total_time = 0.0;
-
+    writer.StartDict().Key("items").StartArray();
     for (auto &edge_id: routing.value().edges) {
-        const graph::Edge<double> edge = rh.ParseGraph().GetEdge(edge_id);
-        items.emplace_back(CreateRouteItemNode(edge));
+        const graph::Edge<double> &edge = rh.ParseGraph().GetEdge(edge_id);
+        WriteRouteItem(edge, writer);
         total_time += edge.weight;
     }
+    writer.EndArray()
+            .Key("request_id").Value(id)
+            .Key("total_time").Value(total_time)
+            .EndDict();
+}
 
-    return CreateRouteResultNode(id, total_time, items);
+void JsonReader::OutSearch(const Json::Schema::StatRequest &request, RequestHandler &rh, Json::Writer &writer) {
+    // Отрицательный limit после приведения к size_t снял бы ограничение на размер ответа
+    if (request.limit < 0) {
+        WriteErrorMessage(request.id, "invalid limit", writer);
+        return;
+    }
+    writer.StartDict().Key("items").StartArray();
+    for (const auto &entry: rh.SearchNames(request.prefix, request.limit)) {
+        writer.StartDict()
+                .Key("name").Value(entry.name)
+                .Key("type").Value(entry.kind == TCatalogue::NameIndex::Kind::BUS ? "Bus" : "Stop")
+                .EndDict();
+    }
+    writer.EndArray()
+            .Key("request_id").Value(request.id)
+            .EndDict();
 }
 
-Json::Node JsonReader::CreateRouteErrorMessageNode(int id, const std::string &message) {
-    return Json::Builder{}
-            .StartDict()
-            .Key("request_id").Value(id)
+void JsonReader::WriteErrorMessage(int id, std::string_view message, Json::Writer &writer) {
+    writer.StartDict()
             .Key("error_message").Value(message)
-            .EndDict()
-            .Build();
+            .Key("request_id").Value(id)
+            .EndDict();
 }
 
-Json::Node JsonReader::CreateRouteItemNode(const graph::Edge<double> &edge) {
-    Json::Dict item;
-
+void JsonReader::WriteRouteItem(const graph::Edge<double> &edge, Json::Writer &writer) {
+    writer.StartDict();
     if (edge.span == 0) {
-        item = {
-                {"stop_name", edge.name},
-                {"time",      edge.weight},
-                {"type",      "Wait"}
-        };
+        writer.Key("stop_name").Value(edge.name)
+                .Key("time").Value(edge.weight)
+                .Key("type").Value("Wait");
     } else {
-        item = {
-                {"bus",        edge.name},
-                {"span_count", static_cast<int>(edge.span)},
-                {"time",       edge.weight},
-                {"type",       "Bus"}
-        };
+        writer.Key("bus").Value(edge.name)
+                .Key("span_count").Value(static_cast<int>(edge.span))
+                .Key("time").Value(edge.weight)
+                .Key("type").Value("Bus");
     }
-
-    return item;
-}
-
-Json::Node JsonReader::CreateRouteResultNode(int id, double total_time, const Json::Array &items) {
-    return Json::Builder{}
-            .StartDict()
-            .Key("request_id").Value(id)
-            .Key("total_time").Value(total_time)
-            .Key("items").Value(items)
-            .EndDict()
-            .Build();
+    writer.EndDict();
 }
 
 const Json::Node &JsonReader::ProcessSerializationSettings() const {
@@ -227,3 +529,7 @@ const Json::Node &JsonReader::ProcessSerializationSettings() const {
     else return nothing_;
 }
 
+template void JsonReader::OutRequest(const Json::Dict &request_map, RequestHandler &rh, Json::Writer &writer);
+
+template void JsonReader::OutRequest(const Json::Compact::Object &request_map, RequestHandler &rh,
+                                     Json::Writer &writer);
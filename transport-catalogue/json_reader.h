@@ -1,10 +1,14 @@
 #pragma once
 
 #include "json.h"
+#include "json_compact.h"
+#include "request_decoder.h"
 #include "transport_catalogue.h"
 #include "map_renderer.h"
 #include "request_handler.h"
+#include <deque>
 #include <iostream>
+#include <unordered_map>
 #include <utility>
 
 class JsonReader {
@@ -13,7 +17,13 @@ public:
             : input_(Json::Load(input)) {}
 
     JsonReader(Json::Document input)
-            : input_(input) {}
+            : input_(std::move(input)) {}
+
+    // Потоково читает документ make_base: base_requests сразу загружаются в справочник,
+    // а в возвращаемом JsonReader остаются только разделы с настройками. Если задан changes,
+    // в него записываются названия затронутых остановок и маршрутов
+    [[nodiscard]] static JsonReader ReadBase(std::istream &input, TCatalogue::TransportCatalogue &catalogue,
+                                             TCatalogue::CatalogueChanges *changes = nullptr);
 
     [[nodiscard]] const Json::Node &ProcessBaseRequests() const;
 
@@ -25,38 +35,108 @@ public:
 
     [[nodiscard]] const Json::Node &ProcessSerializationSettings() const;
 
-    static Json::Node OutRoute(const Json::Dict &request_map, RequestHandler &rh) ;
+    // Ответы пишутся сразу в writer, без промежуточного Json::Node
+    static void OutRoute(const Json::Schema::StatRequest &request, RequestHandler &rh, Json::Writer &writer);
 
-    static Json::Node OutStop(const Json::Dict &request_map, RequestHandler &rh) ;
+    static void OutStop(const Json::Schema::StatRequest &request, RequestHandler &rh, Json::Writer &writer);
 
-    static Json::Node OutMap(const Json::Dict &request_map, RequestHandler &rh) ;
+    static void OutMap(const Json::Schema::StatRequest &request, RequestHandler &rh, Json::Writer &writer);
 
-    static Json::Node OutRouting(const Json::Dict &request_map, RequestHandler &rh);
+    static void OutRouting(const Json::Schema::StatRequest &request, RequestHandler &rh, Json::Writer &writer);
 
-    void FillCatalogue(TCatalogue::TransportCatalogue &TCatalogue);
+    static void OutSearch(const Json::Schema::StatRequest &request, RequestHandler &rh, Json::Writer &writer);
 
-    void ReadJson(const Json::Node &requests, RequestHandler &rh) const;
+    void FillCatalogue(TCatalogue::TransportCatalogue &TCatalogue, TCatalogue::CatalogueChanges *changes = nullptr);
 
-    [[nodiscard]] static TRouting::TRouter FillRouting(const Json::Node &requests) ;
+    void ReadJson(const Json::Node &requests, RequestHandler &rh, std::ostream &output = std::cout) const;
 
+    // Читает разделы документа process_requests до начала stat_requests. Если настройки сериализации
+    // уже известны, сами запросы остаются в потоке и обрабатываются поэлементно в ReadJson
+    [[nodiscard]] static JsonReader ReadUntilStatRequests(Json::Reader &reader);
 
-private:
-    // For routing
-    [[nodiscard]] static Json::Node CreateRouteErrorMessageNode(int id, const std::string &message);
+    // Отвечает на stat_requests, печатая каждый ответ сразу после его подготовки
+    void ReadJson(Json::Reader &reader, RequestHandler &rh, std::ostream &output = std::cout) const;
+
+    // Отвечает на отдельную пачку запросов: массив stat_requests или документ с таким разделом
+    static void ReadBatch(std::string_view batch, RequestHandler &rh, std::ostream &output);
+
+    static void OutRequest(const Json::Schema::StatRequest &request, RequestHandler &rh, Json::Writer &writer);
 
-    [[nodiscard]] static Json::Node CreateRouteItemNode(const graph::Edge<double> &edge);
+    // Печатает ответ на запрос, не подошедший под схему: Json::Dict или Json::Compact::Object.
+    // Запросы неизвестного типа пропускаются
+    template<typename Request>
+    static void OutRequest(const Request &request_map, RequestHandler &rh, Json::Writer &writer);
 
-    [[nodiscard]] static Json::Node CreateRouteResultNode(int id, double total_time, const Json::Array &items);
+    [[nodiscard]] static TRouting::TRouter FillRouting(const Json::Node &requests) ;
+
+    // Тела ответов на запросы Bus и Stop для всех маршрутов и остановок справочника
+    [[nodiscard]] static TCatalogue::ResponseFragments MakeResponseFragments(
+            const TCatalogue::TransportCatalogue &catalogue);
+
+    // true, если в serialization_settings включено "precompute_responses"
+    [[nodiscard]] static bool PrecomputeResponses(const Json::Dict &serialization_settings);
 
-    [[nodiscard]] static std::tuple<std::string_view, Geo::Coordinates, std::map<std::string_view, int>>
-    ProcessStop(const Json::Dict &request_map) ;
+    // true, если в serialization_settings включено "precompute_map"
+    [[nodiscard]] static bool PrecomputeMap(const Json::Dict &serialization_settings);
 
-    void ProcessDistances(TCatalogue::TransportCatalogue &TCatalogue) const;
 
-    static std::tuple<std::string_view, std::vector<std::string>, bool>
-    ProcessBus(const Json::Dict &request_map, TCatalogue::TransportCatalogue &catalogue) ;
+private:
+    static void WriteErrorMessage(int id, std::string_view message, Json::Writer &writer);
+
+    // For routing
+    static void WriteRouteItem(const graph::Edge<double> &edge, Json::Writer &writer);
+
+    // Названия остановок из маршрутов и расстояний, сведённые к номерам. Уже добавленная остановка
+    // запоминается указателем, а название ещё не встреченной копируется один раз на всю загрузку
+    class StopRefs {
+    public:
+        uint32_t Intern(std::string_view name, const TCatalogue::TransportCatalogue &catalogue);
+
+        // Остановки по номерам; вызывается после добавления всех остановок
+        [[nodiscard]] std::vector<const TCatalogue::Stop *> Resolve(
+                const TCatalogue::TransportCatalogue &catalogue) const;
+
+    private:
+        // Ключи указывают в названия остановок справочника или в copies_
+        std::unordered_map<std::string_view, uint32_t> ids_;
+        std::vector<std::string_view> names_;
+        std::vector<const TCatalogue::Stop *> stops_;
+        std::deque<std::string> copies_;
+    };
+
+    // Ссылка на остановку, которая встретится в base_requests позже ссылающегося на неё запроса
+    struct PendingDistance {
+        const TCatalogue::Stop *from;
+        uint32_t to;
+        int distance;
+    };
+
+    // Маршруты добавляются после всех остановок и расстояний
+    struct PendingBus {
+        std::string name;
+        std::vector<uint32_t> stops;
+        bool is_loop;
+    };
+
+    struct PendingRequests {
+        StopRefs stops;
+        std::vector<PendingDistance> distances;
+        std::vector<PendingBus> buses;
+    };
+
+    // Запрос из DOM в виде схемы; false для запросов неизвестного типа
+    static bool ToBaseRequest(const Json::Dict &request_map, Json::Schema::BaseRequest &request);
+
+    static void ProcessBaseRequest(const Json::Schema::BaseRequest &request, TCatalogue::TransportCatalogue &catalogue,
+                                   PendingRequests &pending, TCatalogue::CatalogueChanges *changes = nullptr);
+
+    static void ProcessStop(const Json::Schema::BaseRequest &request, TCatalogue::TransportCatalogue &catalogue,
+                            PendingRequests &pending, TCatalogue::CatalogueChanges *changes);
+
+    static void ProcessPending(const PendingRequests &pending, TCatalogue::TransportCatalogue &catalogue);
 
     Json::Node nothing_ = nullptr;
     Json::Document input_;
+    bool stat_requests_in_stream_ = false;
 
 };
\ No newline at end of file
@@ -0,0 +1,350 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#endif
+
+namespace Json::Detail {
+
+    inline bool IsSpace(char ch) {
+        return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+    }
+
+    // Ищет в [it, end) ближайший символ, требующий отдельной обработки в строковом литерале:
+    // кавычку, обратную косую черту или управляющий символ (меньше 0x20)
+    inline const char *FindStringSpecial(const char *it, const char *end) {
+#if defined(__SSE2__) && defined(__GNUC__)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i max_control = _mm_set1_epi8(0x1F);
+        while (end - it >= 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(it));
+            // Беззнаковое сравнение chunk <= 0x1F: минимум совпадает с самим байтом
+            const __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, max_control), chunk);
+            const __m128i special = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)), control);
+            const auto mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+            if (mask != 0) {
+                return it + __builtin_ctz(mask);
+            }
+            it += 16;
+        }
+#endif
+        while (it != end && *it != '"' && *it != '\\' && static_cast<unsigned char>(*it) >= 0x20) {
+            ++it;
+        }
+        return it;
+    }
+
+    // Проверяет UTF-8 последовательность, начинающуюся с байта не из ASCII, и возвращает
+    // указатель на следующий за ней символ. Отвергает избыточные формы и суррогаты
+    inline const char *SkipUtf8Sequence(const char *it, const char *end) {
+        const auto lead = static_cast<unsigned char>(*it);
+        size_t length;
+        unsigned char min_second = 0x80;
+        unsigned char max_second = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            length = 2;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            length = 3;
+            if (lead == 0xE0) min_second = 0xA0;
+            if (lead == 0xED) max_second = 0x9F;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            length = 4;
+            if (lead == 0xF0) min_second = 0x90;
+            if (lead == 0xF4) max_second = 0x8F;
+        } else {
+            throw ParsingError("Invalid UTF-8 in string");
+        }
+        if (static_cast<size_t>(end - it) < length) {
+            throw ParsingError("Invalid UTF-8 in string");
+        }
+        const auto second = static_cast<unsigned char>(it[1]);
+        if (second < min_second || second > max_second) {
+            throw ParsingError("Invalid UTF-8 in string");
+        }
+        for (size_t i = 2; i < length; ++i) {
+            if ((static_cast<unsigned char>(it[i]) & 0xC0) != 0x80) {
+                throw ParsingError("Invalid UTF-8 in string");
+            }
+        }
+        return it + length;
+    }
+
+    // Ищет конец отрезка строкового литерала, который можно скопировать как есть: кавычку,
+    // обратную косую черту или перевод строки. Попутно проверяет пропущенные символы: корректность
+    // UTF-8 и отсутствие управляющих символов. Блоки из ASCII и двухбайтовых последовательностей
+    // (кириллица, латиница с диакритикой) проверяются по 16 байт за раз, остальное — посимвольно
+    inline const char *ScanStringRun(const char *it, const char *end) {
+        while (true) {
+#if defined(__SSE2__) && defined(__GNUC__)
+            // В знаковом сравнении байты 0x80–0xBF (продолжения) меньше -64,
+            // а 0xC2–0xDF (начала двухбайтовых последовательностей) лежат в (-63, -32)
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            while (end - it >= 16) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(it));
+                const __m128i is_ascii = _mm_cmpgt_epi8(chunk, _mm_set1_epi8(0x1F));
+                const __m128i is_continuation = _mm_cmplt_epi8(chunk, _mm_set1_epi8(-64));
+                const __m128i is_lead = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(-63)),
+                                                      _mm_cmplt_epi8(chunk, _mm_set1_epi8(-32)));
+                // Отрезок всегда начинается на границе символа, поэтому в первый байт сдвигается ноль
+                const __m128i after_lead = _mm_slli_si128(is_lead, 1);
+                const __m128i known = _mm_or_si128(is_ascii, _mm_or_si128(is_lead, is_continuation));
+                const __m128i stop = _mm_or_si128(
+                        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                        _mm_or_si128(_mm_andnot_si128(known, _mm_set1_epi8(-1)),
+                                     _mm_xor_si128(is_continuation, after_lead)));
+                const auto mask = static_cast<unsigned>(_mm_movemask_epi8(stop));
+                const auto leads = static_cast<unsigned>(_mm_movemask_epi8(is_lead));
+                if (mask == 0) {
+                    // Последовательность, начатая в последнем байте, проверяется со следующим блоком
+                    it += (leads & 0x8000u) ? 15 : 16;
+                    continue;
+                }
+                const auto index = static_cast<unsigned>(__builtin_ctz(mask));
+                // Начало последовательности перед остановкой разбирается посимвольно вместе с ней
+                it += (index != 0 && (leads >> (index - 1)) & 1u) ? index - 1 : index;
+                break;
+            }
+#endif
+            if (it == end) {
+                return it;
+            }
+            const auto c = static_cast<unsigned char>(*it);
+            if (c == '"' || c == '\\' || c == '\n' || c == '\r') {
+                return it;
+            }
+            if (c >= 0x80) {
+                it = SkipUtf8Sequence(it, end);
+            } else if (c < 0x20) {
+                throw ParsingError("Control character in string");
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // Дописывает в out символ Юникода в кодировке UTF-8
+    template<typename Out>
+    void AppendUtf8(Out &out, uint32_t code_point) {
+        if (code_point < 0x80) {
+            out.push_back(static_cast<char>(code_point));
+        } else if (code_point < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        } else if (code_point < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        }
+    }
+
+    // Общая для разборщиков JSON часть: продвижение по непрерывному буферу и поиск границ лексем
+    class Scanner {
+    public:
+        explicit Scanner(std::string_view text)
+                : pos_(text.data()), end_(text.data() + text.size()) {
+        }
+
+    protected:
+        // Границы числового литерала и признак того, что в нём нет дробной части и экспоненты
+        struct NumberToken {
+            const char *begin;
+            const char *end;
+            bool is_int;
+        };
+
+        void SkipWhitespace() {
+            if (pos_ != end_ && !IsSpace(*pos_)) {
+                return;
+            }
+#if defined(__SSE2__) && defined(__GNUC__)
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i newline = _mm_set1_epi8('\n');
+            const __m128i carriage = _mm_set1_epi8('\r');
+            const __m128i tab = _mm_set1_epi8('\t');
+            while (end_ - pos_ >= 16) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos_));
+                const __m128i is_space = _mm_or_si128(
+                        _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, newline)),
+                        _mm_or_si128(_mm_cmpeq_epi8(chunk, carriage), _mm_cmpeq_epi8(chunk, tab)));
+                const unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(is_space)) & 0xFFFFu;
+                if (mask != 0) {
+                    pos_ += __builtin_ctz(mask);
+                    return;
+                }
+                pos_ += 16;
+            }
+#endif
+            while (pos_ != end_ && IsSpace(*pos_)) {
+                ++pos_;
+            }
+        }
+
+        // Пропускает пробельные символы и возвращает следующий символ, не сдвигаясь с него
+        char NextToken() {
+            SkipWhitespace();
+            if (pos_ == end_) {
+                throw ParsingError("Unexpected end of input");
+            }
+            return *pos_;
+        }
+
+        // Ищет ближайший символ, требующий отдельной обработки внутри строкового литерала
+        [[nodiscard]] const char *FindStringSpecial() const {
+            return Detail::FindStringSpecial(pos_, end_);
+        }
+
+        // То же, но с проверкой кодировки пропущенного отрезка: так разбирается содержимое строк
+        [[nodiscard]] const char *ScanStringRun() const {
+            return Detail::ScanStringRun(pos_, end_);
+        }
+
+        void ExpectKeyword(std::string_view keyword) {
+            if (static_cast<size_t>(end_ - pos_) < keyword.size()
+                || std::string_view(pos_, keyword.size()) != keyword) {
+                throw ParsingError("Unexpected token, expected " + std::string(keyword));
+            }
+            pos_ += keyword.size();
+        }
+
+        // Считывает escape-последовательность после обратной косой черты и дописывает
+        // раскодированный символ в out. Суррогатные пары \uD8xx\uDCxx собираются в один символ
+        template<typename Out>
+        void AppendEscape(Out &out) {
+            if (pos_ == end_) {
+                // Поток завершился сразу после символа обратной косой черты
+                throw ParsingError("String parsing error");
+            }
+            const char escaped_char = *pos_++;
+            switch (escaped_char) {
+                case 'n':
+                    out.push_back('\n');
+                    break;
+                case 't':
+                    out.push_back('\t');
+                    break;
+                case 'r':
+                    out.push_back('\r');
+                    break;
+                case 'b':
+                    out.push_back('\b');
+                    break;
+                case 'f':
+                    out.push_back('\f');
+                    break;
+                case '"':
+                case '\\':
+                case '/':
+                    out.push_back(escaped_char);
+                    break;
+                case 'u': {
+                    uint32_t code_point = LoadHex4();
+                    if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+                        throw ParsingError("Unpaired surrogate in string");
+                    }
+                    if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+                        if (end_ - pos_ < 2 || pos_[0] != '\\' || pos_[1] != 'u') {
+                            throw ParsingError("Unpaired surrogate in string");
+                        }
+                        pos_ += 2;
+                        const uint32_t low = LoadHex4();
+                        if (low < 0xDC00 || low > 0xDFFF) {
+                            throw ParsingError("Unpaired surrogate in string");
+                        }
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    AppendUtf8(out, code_point);
+                    break;
+                }
+                default:
+                    // Встретили неизвестную escape-последовательность
+                    throw ParsingError(std::string("Unrecognized escape sequence \\") + escaped_char);
+            }
+        }
+
+        uint32_t LoadHex4() {
+            if (end_ - pos_ < 4) {
+                throw ParsingError("String parsing error");
+            }
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i) {
+                const char c = *pos_++;
+                value <<= 4;
+                if (c >= '0' && c <= '9') {
+                    value |= static_cast<uint32_t>(c - '0');
+                } else if (c >= 'a' && c <= 'f') {
+                    value |= static_cast<uint32_t>(c - 'a' + 10);
+                } else if (c >= 'A' && c <= 'F') {
+                    value |= static_cast<uint32_t>(c - 'A' + 10);
+                } else {
+                    throw ParsingError("Invalid \\u escape sequence");
+                }
+            }
+            return value;
+        }
+
+        NumberToken ScanNumber() {
+            const char *begin = pos_;
+
+            auto is_digit = [this] {
+                return pos_ != end_ && *pos_ >= '0' && *pos_ <= '9';
+            };
+
+            // Считывает одну или более цифр
+            auto read_digits = [this, &is_digit] {
+                if (!is_digit()) {
+                    throw ParsingError("A digit is expected");
+                }
+                while (is_digit()) {
+                    ++pos_;
+                }
+            };
+
+            if (pos_ != end_ && *pos_ == '-') {
+                ++pos_;
+            }
+            if (pos_ != end_ && *pos_ == '0') {
+                ++pos_;
+            } else {
+                read_digits();
+            }
+
+            bool is_int = true;
+            // Парсим дробную часть числа
+            if (pos_ != end_ && *pos_ == '.') {
+                ++pos_;
+                read_digits();
+                is_int = false;
+            }
+
+            // Парсим экспоненциальную часть числа
+            if (pos_ != end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+                ++pos_;
+                if (pos_ != end_ && (*pos_ == '+' || *pos_ == '-')) {
+                    ++pos_;
+                }
+                read_digits();
+                is_int = false;
+            }
+
+            return {begin, pos_, is_int};
+        }
+
+        const char *pos_;
+        const char *end_;
+    };
+
+}
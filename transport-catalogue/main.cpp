@@ -5,7 +5,8 @@
 #include "map_renderer.h"
 #include "transport_router.h"
 #include "serialization.h"
-#include <fstream>
+#include "base_update.h"
+#include "server.h"
 #include <iostream>
 #include <string>
 #include <string_view>
@@ -14,36 +15,73 @@
 using namespace std::literals;
 
 void PrintUsage(std::ostream &stream = std::cerr) {
-    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv
+           << "       transport_catalogue make_base --update\n"sv
+           << "       transport_catalogue serve <base file> [<unix socket>]\n"sv;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
+    if (argc < 2) {
         PrintUsage();
         return 1;
     }
 
     const std::string_view mode(argv[1]);
+    const bool update = mode == "make_base"sv && argc == 3 && argv[2] == "--update"sv;
+    if ((mode == "serve"sv) ? (argc != 3 && argc != 4) : (argc != 2 && !update)) {
+        PrintUsage();
+        return 1;
+    }
 
-    if (mode == "make_base"sv) {
-        JsonReader input(Json::Load(std::cin));
+    if (update) {
+        try {
+            UpdateBase(std::cin);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+    } else if (mode == "make_base"sv) {
         TCatalogue::TransportCatalogue transportCatalogue;
-        input.FillCatalogue(transportCatalogue);
+        JsonReader input = JsonReader::ReadBase(std::cin, transportCatalogue);
+        transportCatalogue.BuildNameIndex();
         Render::MapRenderer renderer(input.ProcessRenderSettings());
         TRouting::TRouter router(JsonReader::FillRouting(input.ProcessRoutingSettings()), transportCatalogue);
-        std::ofstream fout(input.ProcessSerializationSettings().AsDict().at("file"s).AsString(), std::ios::binary);
-        if (fout.is_open()) {
-            Serialize(transportCatalogue, renderer, router, fout);
+        const Json::Dict &settings = input.ProcessSerializationSettings().AsDict();
+        if (JsonReader::PrecomputeResponses(settings)) {
+            transportCatalogue.SetResponseFragments(JsonReader::MakeResponseFragments(transportCatalogue));
+        }
+        if (JsonReader::PrecomputeMap(settings)) {
+            static_cast<void>(renderer.GetMapJson([&] { return transportCatalogue.ReturnAllBus(); }));
+        }
+        try {
+            SaveBase(settings, transportCatalogue, renderer, router);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << '\n';
+            return 1;
         }
     } else if (mode == "process_requests"sv) {
-        JsonReader input_json(Json::Load(std::cin));
-        std::ifstream database(input_json.ProcessSerializationSettings().AsDict().at("file"s).AsString(),
-                               std::ios::binary);
-        if (database) {
-            auto [transportcatalogue, renderer, router, graph, stop_ids] = Deserialize(database);
-            router.SetGraph(std::move(graph), std::move(stop_ids));
-            RequestHandler handler(transportcatalogue, renderer, router);
-            input_json.ReadJson(input_json.ProcessStatRequests(), handler);
+        Json::Reader reader(std::cin);
+        JsonReader input_json = JsonReader::ReadUntilStatRequests(reader);
+        try {
+            const Json::Dict &settings = input_json.ProcessSerializationSettings().AsDict();
+            const Server::Snapshot base(std::string(settings.at("file").AsString()));
+            RequestHandler handler = base.MakeHandler();
+            input_json.ReadJson(reader, handler);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+    } else if (mode == "serve"sv) {
+        try {
+            Server::SnapshotStore store(argv[2]);
+            if (argc == 4) {
+                Server::ServeSocket(store, argv[3]);
+            } else {
+                Server::ServeStdin(store);
+            }
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << '\n';
+            return 1;
         }
     } else {
         PrintUsage();
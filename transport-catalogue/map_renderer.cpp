@@ -1,20 +1,24 @@
 #include "map_renderer.h"
 
+#include <sstream>
+
 namespace Render {
 
-    std::vector<Svg::Polyline>
-    MapRenderer::ParseBusLines(const std::map<std::string_view, const TCatalogue::Bus *> &buses,
-                               const Visualization &visualization) const {
-        std::vector<Svg::Polyline> result;
+    void MapRenderer::ParseBusLines(const std::map<std::string_view, const TCatalogue::Bus *> &buses,
+                                    const Visualization &visualization, Svg::Document &result) const {
         size_t color = 0;
         for (const auto &[bus_number, bus]: buses) {
             if (bus->stops.empty()) continue;
-            std::vector<const TCatalogue::Stop *> route_stops{bus->stops.begin(), bus->stops.end()};
-            if (!bus->is_loop) route_stops.insert(route_stops.end(), std::next(bus->stops.rbegin()), bus->stops.rend());
-            Svg::Polyline line;
-            for (const auto &stop: route_stops) {
+            Svg::Polyline &line = result.Emplace<Svg::Polyline>();
+            line.ReservePoints(bus->is_loop ? bus->stops.size() : bus->stops.size() * 2 - 1);
+            for (const auto &stop: bus->stops) {
                 line.AddPoint(visualization(stop->coordinates));
             }
+            if (!bus->is_loop) {
+                for (auto it = std::next(bus->stops.rbegin()); it != bus->stops.rend(); ++it) {
+                    line.AddPoint(visualization((*it)->coordinates));
+                }
+            }
             line.SetStrokeColor(color_palette[color]);
             line.SetFillColor("none");
             line.SetStrokeWidth(line_width);
@@ -24,90 +28,59 @@ namespace Render {
             if (color < (color_palette.size() - 1)) {
                 ++color;
             } else color = 0;
-
-            result.push_back(line);
         }
-
-        return result;
     }
 
-    std::vector<Svg::Text> MapRenderer::ParseBusLabel(const std::map<std::string_view, const TCatalogue::Bus *> &buses,
-                                                      const Visualization &visualization) const {
-        std::vector<Svg::Text> result;
+    void MapRenderer::ParseBusLabel(const std::map<std::string_view, const TCatalogue::Bus *> &buses,
+                                    const Visualization &visualization, Svg::Document &result) const {
         size_t color_num = 0;
         for (const auto &[bus_number, bus]: buses) {
             if (bus->stops.empty()) continue;
-            Svg::Text text;
-            Svg::Text underlayer;
-            text.SetPosition(visualization(bus->stops[0]->coordinates));
-            text.SetOffset(bus_label_offset);
-            text.SetFontSize(bus_label_font_size);
-            text.SetFontFamily("Verdana");
-            text.SetFontWeight("bold");
-            text.SetData(bus->name);
-            text.SetFillColor(color_palette[color_num]);
-            if (color_num < (color_palette.size() - 1)) ++color_num;
-            else color_num = 0;
-
-            underlayer.SetPosition(visualization(bus->stops[0]->coordinates));
-            underlayer.SetOffset(bus_label_offset);
-            underlayer.SetFontSize(bus_label_font_size);
-            underlayer.SetFontFamily("Verdana");
-            underlayer.SetFontWeight("bold");
-            underlayer.SetData(bus->name);
-            underlayer.SetFillColor(underlayer_color);
-            underlayer.SetStrokeColor(underlayer_color);
-            underlayer.SetStrokeWidth(underlayer_width);
-            underlayer.SetStrokeLineCap(Svg::StrokeLineCap::ROUND);
-            underlayer.SetStrokeLineJoin(Svg::StrokeLineJoin::ROUND);
+            const bool has_second_end = !bus->is_loop && bus->stops[0] != bus->stops[bus->stops.size() - 1];
+            for (const auto *end: {bus->stops[0], bus->stops[bus->stops.size() - 1]}) {
+                const Svg::Point position = visualization(end->coordinates);
+                Svg::Text &underlayer = result.Emplace<Svg::Text>();
+                underlayer.SetPosition(position);
+                underlayer.SetOffset(bus_label_offset);
+                underlayer.SetFontSize(bus_label_font_size);
+                underlayer.SetFontFamily("Verdana");
+                underlayer.SetFontWeight("bold");
+                underlayer.SetData(bus->name);
+                underlayer.SetFillColor(underlayer_color);
+                underlayer.SetStrokeColor(underlayer_color);
+                underlayer.SetStrokeWidth(underlayer_width);
+                underlayer.SetStrokeLineCap(Svg::StrokeLineCap::ROUND);
+                underlayer.SetStrokeLineJoin(Svg::StrokeLineJoin::ROUND);
 
-            result.push_back(underlayer);
-            result.push_back(text);
-
-            if (!bus->is_loop && bus->stops[0] != bus->stops[bus->stops.size() - 1]) {
-                Svg::Text text2{text};
-                Svg::Text underlayer2{underlayer};
-                text2.SetPosition(visualization(bus->stops[bus->stops.size() - 1]->coordinates));
-                underlayer2.SetPosition(visualization(bus->stops[bus->stops.size() - 1]->coordinates));
-
-                result.push_back(underlayer2);
-                result.push_back(text2);
+                Svg::Text &text = result.Emplace<Svg::Text>();
+                text.SetPosition(position);
+                text.SetOffset(bus_label_offset);
+                text.SetFontSize(bus_label_font_size);
+                text.SetFontFamily("Verdana");
+                text.SetFontWeight("bold");
+                text.SetData(bus->name);
+                text.SetFillColor(color_palette[color_num]);
+                if (!has_second_end) break;
             }
+            if (color_num < (color_palette.size() - 1)) ++color_num;
+            else color_num = 0;
         }
-
-        return result;
     }
 
-    std::vector<Svg::Circle>
-    MapRenderer::ParseStopsSymbols(const std::map<std::string_view, const TCatalogue::Stop *> &stops,
-                                   const Visualization &visualization) const {
-        std::vector<Svg::Circle> result;
+    void MapRenderer::ParseStopsSymbols(const std::map<std::string_view, const TCatalogue::Stop *> &stops,
+                                        const Visualization &visualization, Svg::Document &result) const {
         for (const auto &[stop_name, stop]: stops) {
-            Svg::Circle symbol;
-            symbol.SetCenter(visualization(stop->coordinates));
-            symbol.SetRadius(stop_radius);
-            symbol.SetFillColor("white");
-
-            result.push_back(symbol);
+            result.Emplace<Svg::Circle>()
+                    .SetCenter(visualization(stop->coordinates))
+                    .SetRadius(stop_radius)
+                    .SetFillColor("white");
         }
-
-        return result;
     }
 
-    std::vector<Svg::Text>
-    MapRenderer::ParseStopsLabels(const std::map<std::string_view, const TCatalogue::Stop *> &stops,
-                                  const Visualization &visualization) const {
-        std::vector<Svg::Text> result;
-        Svg::Text text;
-        Svg::Text underlayer;
+    void MapRenderer::ParseStopsLabels(const std::map<std::string_view, const TCatalogue::Stop *> &stops,
+                                       const Visualization &visualization, Svg::Document &result) const {
         for (const auto &[stop_name, stop]: stops) {
-            text.SetPosition(visualization(stop->coordinates));
-            text.SetOffset(stop_label_offset);
-            text.SetFontSize(stop_label_font_size);
-            text.SetFontFamily("Verdana");
-            text.SetData(stop->name);
-            text.SetFillColor("black");
-
+            Svg::Text &underlayer = result.Emplace<Svg::Text>();
             underlayer.SetPosition(visualization(stop->coordinates));
             underlayer.SetOffset(stop_label_offset);
             underlayer.SetFontSize(stop_label_font_size);
@@ -119,20 +92,29 @@ namespace Render {
             underlayer.SetStrokeLineCap(Svg::StrokeLineCap::ROUND);
             underlayer.SetStrokeLineJoin(Svg::StrokeLineJoin::ROUND);
 
-            result.push_back(underlayer);
-            result.push_back(text);
+            Svg::Text &text = result.Emplace<Svg::Text>();
+            text.SetPosition(visualization(stop->coordinates));
+            text.SetOffset(stop_label_offset);
+            text.SetFontSize(stop_label_font_size);
+            text.SetFontFamily("Verdana");
+            text.SetData(stop->name);
+            text.SetFillColor("black");
         }
-
-        return result;
     }
 
+    // Фигуры создаются прямо в документе; его размер известен заранее, поэтому вектор фигур
+    // выделяется один раз
     Svg::Document MapRenderer::ParseSvg(const std::map<std::string_view, const TCatalogue::Bus *> &buses) const {
         Svg::Document result;
         std::vector<Geo::Coordinates> route_stops_coord;
         std::map<std::string_view, const TCatalogue::Stop *> all_stops;
 
+        size_t lines = 0;
+        size_t bus_labels = 0;
         for (const auto &[bus_number, bus]: buses) {
             if (bus->stops.empty()) continue;
+            ++lines;
+            bus_labels += !bus->is_loop && bus->stops.front() != bus->stops.back() ? 4 : 2;
             for (const auto &stop: bus->stops) {
                 route_stops_coord.push_back(stop->coordinates);
                 all_stops[stop->name] = stop;
@@ -141,14 +123,46 @@ namespace Render {
         Visualization visualization(route_stops_coord.begin(), route_stops_coord.end(), width,
                                     height, padding);
 
-        for (const auto &line: ParseBusLines(buses, visualization)) result.Add(line);
-        for (const auto &text: ParseBusLabel(buses, visualization)) result.Add(text);
-        for (const auto &circle: ParseStopsSymbols(all_stops, visualization)) result.Add(circle);
-        for (const auto &text: ParseStopsLabels(all_stops, visualization)) result.Add(text);
+        result.Reserve(lines + bus_labels + all_stops.size() * 3);
+        ParseBusLines(buses, visualization, result);
+        ParseBusLabel(buses, visualization, result);
+        ParseStopsSymbols(all_stops, visualization, result);
+        ParseStopsLabels(all_stops, visualization, result);
 
         return result;
     }
 
+    void MapRenderer::SetMapJson(std::string map_json) {
+        std::call_once(*map_built_, [&] {
+            map_json_ = std::move(map_json);
+            has_map_ = true;
+        });
+    }
+
+    void MapRenderer::ResetMapJson() {
+        map_json_.clear();
+        has_map_ = false;
+        map_built_ = std::make_unique<std::once_flag>();
+    }
+
+    std::string_view MapRenderer::GetBuiltMapJson() const {
+        return has_map_ ? std::string_view(map_json_) : std::string_view();
+    }
+
+    // SVG печатается сразу в литерал через экранирующий буфер, без промежуточной строки с текстом карты
+    std::string MapRenderer::MakeMapJson(const Svg::Document &map) {
+        std::ostringstream result;
+        {
+            Json::Writer writer(result);
+            writer.Write('"');
+            Json::EscapingBuf escaping(writer);
+            std::ostream svg(&escaping);
+            map.Render(svg);
+            writer.Write('"');
+        }
+        return std::move(result).str();
+    }
+
     MapRenderer::MapRenderer(const Json::Node &render_settings) {
         if (render_settings.IsNull()) return;
         const Json::Dict &request_map = render_settings.AsDict();
@@ -166,7 +180,7 @@ namespace Render {
         stop_label_offset = {stopLabelOffset[0].AsDouble(), stopLabelOffset[1].AsDouble()};
 
         if (request_map.at("underlayer_color").IsString())
-            underlayer_color = request_map.at("underlayer_color").AsString();
+            underlayer_color = std::string(request_map.at("underlayer_color").AsString());
         else if (request_map.at("underlayer_color").IsArray()) {
 
             const Json::Array &underlayercolor = request_map.at("underlayer_color").AsArray();
@@ -187,7 +201,7 @@ namespace Render {
 
         const Json::Array &palette = request_map.at("color_palette").AsArray();
         for (const auto &color_element: palette) {
-            if (color_element.IsString()) color_palette.emplace_back(color_element.AsString());
+            if (color_element.IsString()) color_palette.emplace_back(std::string(color_element.AsString()));
             else if (color_element.IsArray()) {
                 const Json::Array &colorType = color_element.AsArray();
                 if (colorType.size() == 3) {
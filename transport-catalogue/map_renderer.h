@@ -12,6 +12,9 @@
 #include "domain.h"
 
 #include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
 
 namespace Render {
 
@@ -75,23 +78,43 @@ namespace Render {
 
         MapRenderer(const Json::Node &render_settings);
 
-        [[nodiscard]] std::vector<Svg::Polyline>
-        ParseBusLines(const std::map<std::string_view, const TCatalogue::Bus *> &buses,
-                      const Visualization &sp) const;
+        // Фигуры карты добавляются в конец result в порядке их вывода
+        void ParseBusLines(const std::map<std::string_view, const TCatalogue::Bus *> &buses,
+                           const Visualization &sp, Svg::Document &result) const;
 
-        [[nodiscard]] std::vector<Svg::Text>
-        ParseBusLabel(const std::map<std::string_view, const TCatalogue::Bus *> &buses, const Visualization &sp) const;
+        void ParseBusLabel(const std::map<std::string_view, const TCatalogue::Bus *> &buses,
+                           const Visualization &sp, Svg::Document &result) const;
 
-        [[nodiscard]] std::vector<Svg::Circle>
-        ParseStopsSymbols(const std::map<std::string_view, const TCatalogue::Stop *> &stops,
-                          const Visualization &sp) const;
+        void ParseStopsSymbols(const std::map<std::string_view, const TCatalogue::Stop *> &stops,
+                               const Visualization &sp, Svg::Document &result) const;
 
-        [[nodiscard]] std::vector<Svg::Text>
-        ParseStopsLabels(const std::map<std::string_view, const TCatalogue::Stop *> &stops,
-                         const Visualization &sp) const;
+        void ParseStopsLabels(const std::map<std::string_view, const TCatalogue::Stop *> &stops,
+                              const Visualization &sp, Svg::Document &result) const;
 
         [[nodiscard]] Svg::Document ParseSvg(const std::map<std::string_view, const TCatalogue::Bus *> &buses) const;
 
+        // Карта для ответа на запрос Map: строковый литерал JSON с SVG-документом. Строится при первом
+        // вызове по маршрутам из get_buses() и дальше не меняется: маршруты загруженной базы постоянны
+        template<typename GetBuses>
+        [[nodiscard]] const std::string &GetMapJson(GetBuses get_buses) const {
+            std::call_once(*map_built_, [&] {
+                map_json_ = MakeMapJson(ParseSvg(get_buses()));
+                has_map_ = true;
+            });
+            return map_json_;
+        }
+
+        // Готовая карта, например из базы. Вызывается до первого GetMapJson
+        void SetMapJson(std::string map_json);
+
+        // Забывает построенную карту после изменения справочника. Нельзя вызывать одновременно с GetMapJson
+        void ResetMapJson();
+
+        // Пусто, если карта ещё не строилась
+        [[nodiscard]] std::string_view GetBuiltMapJson() const;
+
+        [[nodiscard]] static std::string MakeMapJson(const Svg::Document &map);
+
         Json::Node GetRenderSetup() const;
 
         static Json::Node ConvertPointToNode(const Svg::Point &point);
@@ -114,6 +137,10 @@ namespace Render {
         double underlayer_width = 0.0;
         std::vector<Svg::Color> color_palette{};
 
+        mutable std::string map_json_;
+        mutable bool has_map_ = false;
+        // Флаг лежит в куче, чтобы MapRenderer оставался перемещаемым
+        mutable std::unique_ptr<std::once_flag> map_built_ = std::make_unique<std::once_flag>();
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "name_index.h"
+
+#include <algorithm>
+
+namespace TCatalogue {
+
+    NameIndex::NameIndex(const std::map<std::string_view, const Stop *> &stops,
+                         const std::map<std::string_view, const Bus *> &buses) {
+        std::vector<Key> keys;
+        keys.reserve(stops.size() + buses.size());
+        for (const auto &[name, stop]: stops) {
+            keys.push_back({FoldCase(name), {stop->name, Kind::STOP}});
+        }
+        for (const auto &[name, bus]: buses) {
+            keys.push_back({FoldCase(name), {bus->name, Kind::BUS}});
+        }
+        std::sort(keys.begin(), keys.end(), [](const Key &lhs, const Key &rhs) {
+            if (lhs.first != rhs.first) return lhs.first < rhs.first;
+            if (lhs.second.kind != rhs.second.kind) return lhs.second.kind < rhs.second.kind;
+            return lhs.second.name < rhs.second.name;
+        });
+
+        nodes_.emplace_back();
+        Build(0, keys.begin(), keys.end(), 0);
+    }
+
+    NameIndex::NameIndex(std::string labels, std::vector<Node> nodes, std::vector<Entry> entries)
+            : labels_(std::move(labels)), nodes_(std::move(nodes)), entries_(std::move(entries)) {}
+
+    void NameIndex::Build(uint32_t node_id, KeyIt begin, KeyIt end, size_t depth) {
+        nodes_[node_id].first_entry = static_cast<uint32_t>(entries_.size());
+        while (begin != end && begin->first.size() == depth) {
+            entries_.push_back(begin->second);
+            ++begin;
+        }
+        nodes_[node_id].entry_count = static_cast<uint32_t>(entries_.size()) - nodes_[node_id].first_entry;
+
+        // Ключи отсортированы, поэтому группы с одинаковым очередным байтом идут подряд
+        std::vector<std::pair<KeyIt, KeyIt>> groups;
+        for (auto it = begin; it != end;) {
+            const char ch = it->first[depth];
+            auto group_end = std::find_if(it, end, [depth, ch](const Key &key) { return key.first[depth] != ch; });
+            groups.emplace_back(it, group_end);
+            it = group_end;
+        }
+
+        const auto first_child = static_cast<uint32_t>(nodes_.size());
+        nodes_[node_id].first_child = first_child;
+        nodes_[node_id].child_count = static_cast<uint32_t>(groups.size());
+        nodes_.resize(nodes_.size() + groups.size());
+
+        for (size_t i = 0; i < groups.size(); ++i) {
+            const auto &[group_begin, group_end] = groups[i];
+            const std::string &first = group_begin->first;
+            const std::string &last = std::prev(group_end)->first;
+            size_t common = depth + 1;
+            while (common < first.size() && common < last.size() && first[common] == last[common]) {
+                ++common;
+            }
+
+            Node &child = nodes_[first_child + i];
+            child.label_begin = static_cast<uint32_t>(labels_.size());
+            child.label_size = static_cast<uint32_t>(common - depth);
+            labels_.append(first, depth, common - depth);
+
+            Build(first_child + static_cast<uint32_t>(i), group_begin, group_end, common);
+        }
+    }
+
+    std::vector<NameIndex::Entry> NameIndex::Search(std::string_view prefix, size_t limit) const {
+        std::vector<Entry> result;
+        if (nodes_.empty() || limit == 0) {
+            return result;
+        }
+
+        const std::string key = FoldCase(prefix);
+        std::string_view rest = key;
+        uint32_t node_id = 0;
+        while (!rest.empty()) {
+            const Node &node = nodes_[node_id];
+            const auto children_begin = nodes_.begin() + node.first_child;
+            const auto children_end = children_begin + node.child_count;
+            const auto child = std::lower_bound(children_begin, children_end, rest.front(),
+                                                [this](const Node &lhs, char ch) {
+                                                    return static_cast<unsigned char>(Label(lhs).front()) <
+                                                           static_cast<unsigned char>(ch);
+                                                });
+            if (child == children_end || Label(*child).front() != rest.front()) {
+                return result;
+            }
+
+            const std::string_view label = Label(*child);
+            const size_t compared = std::min(label.size(), rest.size());
+            if (label.substr(0, compared) != rest.substr(0, compared)) {
+                return result;
+            }
+            rest.remove_prefix(compared);
+            node_id = static_cast<uint32_t>(child - nodes_.begin());
+        }
+
+        // Обход в глубину даёт ответы в лексикографическом порядке ключей
+        std::vector<uint32_t> stack{node_id};
+        while (!stack.empty() && result.size() < limit) {
+            const Node &node = nodes_[stack.back()];
+            stack.pop_back();
+            for (uint32_t i = 0; i < node.entry_count && result.size() < limit; ++i) {
+                result.push_back(entries_[node.first_entry + i]);
+            }
+            for (uint32_t i = node.child_count; i > 0; --i) {
+                stack.push_back(node.first_child + i - 1);
+            }
+        }
+
+        return result;
+    }
+
+    const std::string &NameIndex::GetLabels() const {
+        return labels_;
+    }
+
+    const std::vector<NameIndex::Node> &NameIndex::GetNodes() const {
+        return nodes_;
+    }
+
+    const std::vector<NameIndex::Entry> &NameIndex::GetEntries() const {
+        return entries_;
+    }
+
+    std::string_view NameIndex::Label(const Node &node) const {
+        return std::string_view(labels_).substr(node.label_begin, node.label_size);
+    }
+
+    std::string NameIndex::FoldCase(std::string_view text) {
+        std::string result(text);
+        for (size_t i = 0; i < result.size(); ++i) {
+            auto &ch = reinterpret_cast<unsigned char &>(result[i]);
+            if (ch >= 'A' && ch <= 'Z') {
+                ch += 'a' - 'A';
+            } else if (ch == 0xD0 && i + 1 < result.size()) {
+                auto &next = reinterpret_cast<unsigned char &>(result[i + 1]);
+                if (next >= 0x80 && next <= 0x8F) {
+                    // Ѐ-Џ (U+0400-U+040F) -> ѐ-џ (U+0450-U+045F)
+                    ch = 0xD1;
+                    next += 0x10;
+                } else if (next >= 0x90 && next <= 0x9F) {
+                    // А-П -> а-п
+                    next += 0x20;
+                } else if (next >= 0xA0 && next <= 0xAF) {
+                    // Р-Я -> р-я
+                    ch = 0xD1;
+                    next -= 0x20;
+                }
+                ++i;
+            } else if (ch >= 0xC0) {
+                // Пропускаем продолжение многобайтового символа целиком
+                while (i + 1 < result.size() && (static_cast<unsigned char>(result[i + 1]) & 0xC0) == 0x80) {
+                    ++i;
+                }
+            }
+        }
+        return result;
+    }
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "domain.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace TCatalogue {
+
+    // Сжатое префиксное дерево (radix trie) по названиям остановок и маршрутов.
+    // Ключи хранятся в нижнем регистре (латиница и кириллица), метки рёбер лежат в одном буфере.
+    class NameIndex {
+    public:
+        enum class Kind {
+            STOP,
+            BUS,
+        };
+
+        struct Entry {
+            std::string_view name;
+            Kind kind;
+        };
+
+        struct Node {
+            uint32_t label_begin = 0;
+            uint32_t label_size = 0;
+            uint32_t first_child = 0;
+            uint32_t child_count = 0;
+            uint32_t first_entry = 0;
+            uint32_t entry_count = 0;
+        };
+
+        NameIndex() = default;
+
+        NameIndex(const std::map<std::string_view, const Stop *> &stops,
+                  const std::map<std::string_view, const Bus *> &buses);
+
+        NameIndex(std::string labels, std::vector<Node> nodes, std::vector<Entry> entries);
+
+        [[nodiscard]] std::vector<Entry> Search(std::string_view prefix, size_t limit) const;
+
+        [[nodiscard]] const std::string &GetLabels() const;
+
+        [[nodiscard]] const std::vector<Node> &GetNodes() const;
+
+        [[nodiscard]] const std::vector<Entry> &GetEntries() const;
+
+        [[nodiscard]] static std::string FoldCase(std::string_view text);
+
+    private:
+        using Key = std::pair<std::string, Entry>;
+        using KeyIt = std::vector<Key>::const_iterator;
+
+        void Build(uint32_t node_id, KeyIt begin, KeyIt end, size_t depth);
+
+        [[nodiscard]] std::string_view Label(const Node &node) const;
+
+        std::string labels_;
+        std::vector<Node> nodes_;
+        std::vector<Entry> entries_;
+    };
+
+}
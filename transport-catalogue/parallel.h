@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+
+    inline size_t ThreadCount() {
+        static const size_t count = std::max<size_t>(1, std::thread::hardware_concurrency());
+        return count;
+    }
+
+    // Выполняет task(begin, end) для непересекающихся отрезков [0, count) на всех ядрах.
+    // Отрезки раздаются потокам по мере освобождения, поэтому неравномерная нагрузка
+    // выравнивается. Первое исключение из task пробрасывается вызывающему после завершения потоков
+    template<typename Task>
+    void ForEachRange(size_t count, size_t min_block, Task task) {
+        const size_t threads = std::min(ThreadCount(), (count + min_block - 1) / std::max<size_t>(min_block, 1));
+        if (threads <= 1) {
+            if (count != 0) {
+                task(size_t{0}, count);
+            }
+            return;
+        }
+
+        const size_t block = std::max(min_block, count / (threads * 8) + 1);
+        std::atomic<size_t> next{0};
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto worker = [&] {
+            try {
+                for (size_t begin; (begin = next.fetch_add(block)) < count;) {
+                    task(begin, std::min(begin + block, count));
+                }
+            } catch (...) {
+                std::lock_guard guard(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = count;
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (size_t i = 1; i < threads; ++i) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (auto &thread: pool) {
+            thread.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+}
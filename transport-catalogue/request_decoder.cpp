@@ -0,0 +1,382 @@
+#include "request_decoder.h"
+#include "json_scanner.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+
+using namespace std::literals;
+
+namespace Json::Schema {
+
+    namespace {
+
+        // Таблица строковых ключей с совершенным хешированием, построенная при компиляции:
+        // поиск — одно вычисление хеша и одно сравнение строк. Затравка хеша подбирается так,
+        // чтобы все известные ключи попали в разные ячейки
+        template<typename T, size_t N>
+        class KeyMap {
+        public:
+            using Item = std::pair<std::string_view, T>;
+
+            constexpr explicit KeyMap(const Item (&items)[N]) {
+                for (seed_ = 1; seed_ < 100000; ++seed_) {
+                    if (TryBuild(items)) {
+                        return;
+                    }
+                }
+                throw std::logic_error("Perfect hash seed not found");
+            }
+
+            [[nodiscard]] constexpr std::optional<T> Find(std::string_view key) const {
+                const size_t slot = Hash(key, seed_);
+                if (used_[slot] && keys_[slot] == key) {
+                    return values_[slot];
+                }
+                return std::nullopt;
+            }
+
+        private:
+            static constexpr size_t SIZE = std::bit_ceil(N * 2);
+
+            // Длина и три символа ключа: для коротких имён полей этого достаточно
+            static constexpr size_t Hash(std::string_view key, uint32_t seed) {
+                uint32_t hash = seed * 0x9E3779B9u ^ static_cast<uint32_t>(key.size());
+                if (!key.empty()) {
+                    hash = (hash ^ static_cast<unsigned char>(key.front())) * 0x01000193u;
+                    hash = (hash ^ static_cast<unsigned char>(key[key.size() / 2])) * 0x01000193u;
+                    hash = (hash ^ static_cast<unsigned char>(key.back())) * 0x01000193u;
+                }
+                return (hash >> 16) % SIZE;
+            }
+
+            constexpr bool TryBuild(const Item (&items)[N]) {
+                used_ = {};
+                for (const auto &[key, value]: items) {
+                    const size_t slot = Hash(key, seed_);
+                    if (used_[slot]) {
+                        return false;
+                    }
+                    used_[slot] = true;
+                    keys_[slot] = key;
+                    values_[slot] = value;
+                }
+                return true;
+            }
+
+            std::array<std::string_view, SIZE> keys_{};
+            std::array<T, SIZE> values_{};
+            std::array<bool, SIZE> used_{};
+            uint32_t seed_ = 0;
+        };
+
+        template<typename T, size_t N>
+        constexpr KeyMap<T, N> MakeKeyMap(const std::pair<std::string_view, std::type_identity_t<T>> (&items)[N]) {
+            return KeyMap<T, N>(items);
+        }
+
+        enum class StatField : uint32_t {
+            ID, TYPE, NAME, FROM, TO, PREFIX, LIMIT
+        };
+
+        enum class BaseField : uint32_t {
+            TYPE, NAME, LATITUDE, LONGITUDE, ROAD_DISTANCES, STOPS, IS_ROUNDTRIP
+        };
+
+        constexpr auto STAT_FIELDS = MakeKeyMap<StatField>({
+                {"id"sv,     StatField::ID},
+                {"type"sv,   StatField::TYPE},
+                {"name"sv,   StatField::NAME},
+                {"from"sv,   StatField::FROM},
+                {"to"sv,     StatField::TO},
+                {"prefix"sv, StatField::PREFIX},
+                {"limit"sv,  StatField::LIMIT},
+        });
+
+        constexpr auto STAT_TYPES = MakeKeyMap<StatRequest::Type>({
+                {"Stop"sv,   StatRequest::Type::STOP},
+                {"Bus"sv,    StatRequest::Type::BUS},
+                {"Map"sv,    StatRequest::Type::MAP},
+                {"Route"sv,  StatRequest::Type::ROUTE},
+                {"Search"sv, StatRequest::Type::SEARCH},
+        });
+
+        constexpr auto BASE_FIELDS = MakeKeyMap<BaseField>({
+                {"type"sv,           BaseField::TYPE},
+                {"name"sv,           BaseField::NAME},
+                {"latitude"sv,       BaseField::LATITUDE},
+                {"longitude"sv,      BaseField::LONGITUDE},
+                {"road_distances"sv, BaseField::ROAD_DISTANCES},
+                {"stops"sv,          BaseField::STOPS},
+                {"is_roundtrip"sv,   BaseField::IS_ROUNDTRIP},
+        });
+
+        constexpr auto BASE_TYPES = MakeKeyMap<BaseRequest::Type>({
+                {"Stop"sv, BaseRequest::Type::STOP},
+                {"Bus"sv,  BaseRequest::Type::BUS},
+        });
+
+        template<typename Field>
+        constexpr uint32_t Bit(Field field) {
+            return 1u << static_cast<uint32_t>(field);
+        }
+
+        // Разбор значений ожидаемого типа. Методы Read* возвращают false, если значение
+        // другого типа или требует раскодирования; синтаксические ошибки бросают ParsingError
+        class Decoder : private Detail::Scanner {
+        public:
+            using Scanner::Scanner;
+
+            // Перебирает поля объекта. on_field(key) разбирает значение и возвращает false,
+            // если поле не подходит под схему
+            template<typename OnField>
+            bool ForEachField(OnField on_field) {
+                if (NextToken() != '{') {
+                    return false;
+                }
+                ++pos_;
+                if (NextToken() == '}') {
+                    ++pos_;
+                    return true;
+                }
+                while (true) {
+                    std::string_view key;
+                    if (!ReadString(key)) {
+                        return false;
+                    }
+                    if (NextToken() != ':') {
+                        throw ParsingError("Dict error");
+                    }
+                    ++pos_;
+                    if (!on_field(key)) {
+                        return false;
+                    }
+                    const char c = NextToken();
+                    ++pos_;
+                    if (c == '}') {
+                        return true;
+                    } else if (c != ',') {
+                        throw ParsingError("Dict error");
+                    }
+                }
+            }
+
+            template<typename OnItem>
+            bool ForEachItem(OnItem on_item) {
+                if (NextToken() != '[') {
+                    return false;
+                }
+                ++pos_;
+                if (NextToken() == ']') {
+                    ++pos_;
+                    return true;
+                }
+                while (true) {
+                    if (!on_item()) {
+                        return false;
+                    }
+                    const char c = NextToken();
+                    ++pos_;
+                    if (c == ']') {
+                        return true;
+                    } else if (c != ',') {
+                        throw ParsingError("Array error");
+                    }
+                }
+            }
+
+            bool ReadString(std::string_view &value) {
+                if (NextToken() != '"') {
+                    return false;
+                }
+                const char *begin = ++pos_;
+                pos_ = ScanStringRun();
+                if (pos_ == end_) {
+                    throw ParsingError("String parsing error");
+                }
+                if (*pos_ != '"') {
+                    return false;
+                }
+                value = std::string_view(begin, static_cast<size_t>(pos_++ - begin));
+                return true;
+            }
+
+            bool ReadInt(int &value) {
+                if (!AtNumber()) {
+                    return false;
+                }
+                const auto [begin, end, is_int] = ScanNumber();
+                const auto [ptr, ec] = std::from_chars(begin, end, value);
+                return is_int && ec == std::errc() && ptr == end;
+            }
+
+            // Как и Node::AsDouble, принимает и целые числа
+            bool ReadDouble(double &value) {
+                if (!AtNumber()) {
+                    return false;
+                }
+                const auto [begin, end, is_int] = ScanNumber();
+                const auto [ptr, ec] = std::from_chars(begin, end, value);
+                return ec == std::errc() && ptr == end;
+            }
+
+            bool ReadBool(bool &value) {
+                const char c = NextToken();
+                if (c == 't') {
+                    ExpectKeyword("true"sv);
+                    value = true;
+                    return true;
+                }
+                if (c == 'f') {
+                    ExpectKeyword("false"sv);
+                    value = false;
+                    return true;
+                }
+                return false;
+            }
+
+            template<typename T, size_t N>
+            bool ReadEnum(const KeyMap<T, N> &values, T &value) {
+                std::string_view text;
+                if (!ReadString(text)) {
+                    return false;
+                }
+                const auto found = values.Find(text);
+                if (!found) {
+                    return false;
+                }
+                value = *found;
+                return true;
+            }
+
+        private:
+            bool AtNumber() {
+                const char c = NextToken();
+                return c == '-' || (c >= '0' && c <= '9');
+            }
+        };
+
+        // Поля, без которых общий путь бросил бы исключение
+        uint32_t RequiredFields(StatRequest::Type type) {
+            const uint32_t common = Bit(StatField::ID) | Bit(StatField::TYPE);
+            switch (type) {
+                case StatRequest::Type::STOP:
+                case StatRequest::Type::BUS:
+                    return common | Bit(StatField::NAME);
+                case StatRequest::Type::ROUTE:
+                    return common | Bit(StatField::FROM) | Bit(StatField::TO);
+                case StatRequest::Type::SEARCH:
+                    return common | Bit(StatField::PREFIX);
+                case StatRequest::Type::MAP:
+                    break;
+            }
+            return common;
+        }
+
+        uint32_t RequiredFields(BaseRequest::Type type) {
+            const uint32_t common = Bit(BaseField::TYPE) | Bit(BaseField::NAME);
+            if (type == BaseRequest::Type::STOP) {
+                return common | Bit(BaseField::LATITUDE) | Bit(BaseField::LONGITUDE) | Bit(BaseField::ROAD_DISTANCES);
+            }
+            return common | Bit(BaseField::STOPS) | Bit(BaseField::IS_ROUNDTRIP);
+        }
+
+    }  // namespace
+
+    bool DecodeStatRequest(std::string_view text, StatRequest &request) {
+        request = StatRequest{};
+        Decoder decoder(text);
+        uint32_t seen = 0;
+        const bool decoded = decoder.ForEachField([&](std::string_view key) {
+            const auto field = STAT_FIELDS.Find(key);
+            // Повтор ключа тоже отдаём общему пути: там действует первое значение
+            if (!field || (seen & Bit(*field))) {
+                return false;
+            }
+            seen |= Bit(*field);
+            switch (*field) {
+                case StatField::ID:
+                    return decoder.ReadInt(request.id);
+                case StatField::TYPE:
+                    return decoder.ReadEnum(STAT_TYPES, request.type);
+                case StatField::NAME:
+                    return decoder.ReadString(request.name);
+                case StatField::FROM:
+                    return decoder.ReadString(request.from);
+                case StatField::TO:
+                    return decoder.ReadString(request.to);
+                case StatField::PREFIX:
+                    return decoder.ReadString(request.prefix);
+                case StatField::LIMIT:
+                    return decoder.ReadInt(request.limit);
+            }
+            return false;
+        });
+        if (!decoded || !(seen & Bit(StatField::TYPE))) {
+            return false;
+        }
+        const uint32_t required = RequiredFields(request.type);
+        return (seen & required) == required;
+    }
+
+    bool DecodeBaseRequest(std::string_view text, BaseRequest &request) {
+        request.type = BaseRequest::Type::STOP;
+        request.name = {};
+        request.latitude = request.longitude = 0.0;
+        request.road_distances.clear();
+        request.stops.clear();
+        request.is_roundtrip = false;
+
+        Decoder decoder(text);
+        uint32_t seen = 0;
+        const bool decoded = decoder.ForEachField([&](std::string_view key) {
+            const auto field = BASE_FIELDS.Find(key);
+            if (!field || (seen & Bit(*field))) {
+                return false;
+            }
+            seen |= Bit(*field);
+            switch (*field) {
+                case BaseField::TYPE:
+                    return decoder.ReadEnum(BASE_TYPES, request.type);
+                case BaseField::NAME:
+                    return decoder.ReadString(request.name);
+                case BaseField::LATITUDE:
+                    return decoder.ReadDouble(request.latitude);
+                case BaseField::LONGITUDE:
+                    return decoder.ReadDouble(request.longitude);
+                case BaseField::ROAD_DISTANCES:
+                    return decoder.ForEachField([&](std::string_view stop) {
+                        int distance = 0;
+                        if (!decoder.ReadInt(distance)) {
+                            return false;
+                        }
+                        // Как и в Json::Dict, из повторяющихся ключей действует первый. Расстояний
+                        // у остановки немного, поэтому повтор ищется простым перебором
+                        const auto &distances = request.road_distances;
+                        if (std::none_of(distances.begin(), distances.end(),
+                                         [stop](const auto &item) { return item.first == stop; })) {
+                            request.road_distances.emplace_back(stop, distance);
+                        }
+                        return true;
+                    });
+                case BaseField::STOPS:
+                    return decoder.ForEachItem([&] {
+                        return decoder.ReadString(request.stops.emplace_back());
+                    });
+                case BaseField::IS_ROUNDTRIP:
+                    return decoder.ReadBool(request.is_roundtrip);
+            }
+            return false;
+        });
+        if (!decoded || !(seen & Bit(BaseField::TYPE))) {
+            return false;
+        }
+        const uint32_t required = RequiredFields(request.type);
+        return (seen & required) == required;
+    }
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Разбор запросов известного вида сразу в структуры, минуя Json::Node. Строки в результатах
+// указывают во входной текст. Если запрос не укладывается в схему (незнакомое поле, значение
+// другого типа, escape-последовательность в строке), декодер возвращает false, и запрос
+// разбирается общим путём через DOM
+namespace Json::Schema {
+
+    struct StatRequest {
+        enum class Type : uint8_t {
+            STOP, BUS, MAP, ROUTE, SEARCH
+        };
+
+        Type type = Type::STOP;
+        int id = 0;
+        std::string_view name;
+        std::string_view from;
+        std::string_view to;
+        std::string_view prefix;
+        int limit = 10;
+    };
+
+    struct BaseRequest {
+        enum class Type : uint8_t {
+            STOP, BUS
+        };
+
+        Type type = Type::STOP;
+        std::string_view name;
+        // Для остановки
+        double latitude = 0.0;
+        double longitude = 0.0;
+        std::vector<std::pair<std::string_view, int>> road_distances;
+        // Для маршрута
+        std::vector<std::string_view> stops;
+        bool is_roundtrip = false;
+    };
+
+    // Заполняет request; векторы в BaseRequest переиспользуются между вызовами
+    bool DecodeStatRequest(std::string_view text, StatRequest &request);
+
+    bool DecodeBaseRequest(std::string_view text, BaseRequest &request);
+
+}
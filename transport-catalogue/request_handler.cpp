@@ -24,10 +24,29 @@ bool RequestHandler::IsStopName(const std::string_view stop_name) const {
     return catalogue_.FindStop(stop_name);
 }
 
+std::vector<TCatalogue::NameIndex::Entry>
+RequestHandler::SearchNames(const std::string_view prefix, const size_t limit) const {
+    return catalogue_.GetNameIndex().Search(prefix, limit);
+}
+
+const TCatalogue::ResponseFragments::Fragment *
+RequestHandler::FindBusResponse(const std::string_view bus_number) const {
+    return catalogue_.GetResponseFragments().FindBus(bus_number);
+}
+
+const TCatalogue::ResponseFragments::Fragment *
+RequestHandler::FindStopResponse(const std::string_view stop_name) const {
+    return catalogue_.GetResponseFragments().FindStop(stop_name);
+}
+
 Svg::Document RequestHandler::RenderMap() const {
     return renderer_.ParseSvg(catalogue_.ReturnAllBus());
 }
 
+const std::string &RequestHandler::RenderMapJson() const {
+    return renderer_.GetMapJson([this] { return catalogue_.ReturnAllBus(); });
+}
+
 std::optional<graph::Router<double>::RouteInfo>
 RequestHandler::FetchRoute(const std::string_view stop_from, const std::string_view stop_to) const {
     return router_.FindRoute(stop_from, stop_to);
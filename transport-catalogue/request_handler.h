@@ -19,9 +19,17 @@ public:
     [[nodiscard]] std::set<std::string> GetBusesByStop(std::string_view stop_name) const;
     [[nodiscard]] bool IsBusNumber(std::string_view bus_number) const;
     [[nodiscard]] bool IsStopName(std::string_view stop_name) const;
+    [[nodiscard]] std::vector<TCatalogue::NameIndex::Entry> SearchNames(std::string_view prefix, size_t limit) const;
+
+    // Готовые ответы из базы; nullptr, если их нет
+    [[nodiscard]] const TCatalogue::ResponseFragments::Fragment *FindBusResponse(std::string_view bus_number) const;
+    [[nodiscard]] const TCatalogue::ResponseFragments::Fragment *FindStopResponse(std::string_view stop_name) const;
 
     [[nodiscard]] Svg::Document RenderMap() const;
 
+    // Строковый литерал JSON с картой; строится один раз на загруженную базу
+    [[nodiscard]] const std::string &RenderMapJson() const;
+
     [[nodiscard]] std::optional<graph::Router<double>::RouteInfo> FetchRoute(std::string_view stop_from, const std::string_view stop_to) const;
     [[nodiscard]] const graph::DirectedWeightedGraph<double>& ParseGraph() const;
 
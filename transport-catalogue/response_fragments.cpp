@@ -0,0 +1,37 @@
+#include "response_fragments.h"
+
+#include <utility>
+
+namespace TCatalogue {
+
+    std::string_view ResponseFragments::Fragment::Head() const {
+        return std::string_view(text).substr(0, split);
+    }
+
+    std::string_view ResponseFragments::Fragment::Tail() const {
+        return std::string_view(text).substr(split);
+    }
+
+    void ResponseFragments::AddStop(std::string_view name, Fragment fragment) {
+        stops_.insert_or_assign(name, std::move(fragment));
+    }
+
+    void ResponseFragments::AddBus(std::string_view name, Fragment fragment) {
+        buses_.insert_or_assign(name, std::move(fragment));
+    }
+
+    const ResponseFragments::Fragment *ResponseFragments::FindStop(std::string_view name) const {
+        const auto it = stops_.find(name);
+        return it == stops_.end() ? nullptr : &it->second;
+    }
+
+    const ResponseFragments::Fragment *ResponseFragments::FindBus(std::string_view name) const {
+        const auto it = buses_.find(name);
+        return it == buses_.end() ? nullptr : &it->second;
+    }
+
+    bool ResponseFragments::Empty() const {
+        return stops_.empty() && buses_.empty();
+    }
+
+}
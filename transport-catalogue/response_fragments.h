@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace TCatalogue {
+
+    // Готовые тела ответов на запросы Bus и Stop, построенные при make_base. Значение request_id
+    // в них пропущено: оно вставляется при ответе по смещению split. Ключи — названия из справочника,
+    // поэтому фрагменты живут не дольше него. split не больше длины text
+    class ResponseFragments {
+    public:
+        struct Fragment {
+            std::string text;
+            uint32_t split = 0;
+
+            // Текст до значения request_id
+            [[nodiscard]] std::string_view Head() const;
+
+            // Текст после значения request_id
+            [[nodiscard]] std::string_view Tail() const;
+        };
+
+        void AddStop(std::string_view name, Fragment fragment);
+
+        void AddBus(std::string_view name, Fragment fragment);
+
+        // nullptr, если фрагмента нет
+        [[nodiscard]] const Fragment *FindStop(std::string_view name) const;
+
+        [[nodiscard]] const Fragment *FindBus(std::string_view name) const;
+
+        [[nodiscard]] bool Empty() const;
+
+    private:
+        std::unordered_map<std::string_view, Fragment> stops_;
+        std::unordered_map<std::string_view, Fragment> buses_;
+    };
+
+}
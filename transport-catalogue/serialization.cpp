@@ -1,48 +1,222 @@
 #include "serialization.h"
+#include "base_file.h"
+#include "parallel.h"
+
+#include <google/protobuf/arena.h>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
 
 using namespace std;
 
+namespace {
+
+    // Версия схемы protobuf, которую пишет Serialize
+    constexpr uint32_t PROTOBUF_VERSION = 3;
+
+    // Остановок или маршрутов в одном фрагменте protobuf, кодируемом отдельным потоком
+    constexpr size_t RECORDS_PER_CHUNK = 2048;
+    // Фрагменты базы, кроме остановок и маршрутов, в порядке номеров их полей
+    enum class TailChunk {
+        RENDER_SETTINGS, ROUTER, NAME_INDEX, VERSION, MAP_JSON, COUNT
+    };
+
+    void CheckIndex(uint64_t index, size_t size) {
+        if (index >= size) {
+            throw BaseFile::FormatError("Malformed base file reference");
+        }
+    }
+
+    void CheckRange(uint64_t begin, uint64_t count, size_t size) {
+        if (begin > size || count > size - begin) {
+            throw BaseFile::FormatError("Malformed base file reference");
+        }
+    }
+
+    // Узлы индекса названий должны образовывать дерево с корнем 0: дети идут после родителя
+    // и у каждого узла не больше одного родителя. Тогда поиск не зацикливается и не обходит
+    // узлы повторно. Метки детей непусты: поиск сравнивает их первый символ
+    void CheckNameIndex(const std::vector<TCatalogue::NameIndex::Node> &nodes, size_t labels_size,
+                        size_t entries_size) {
+        std::vector<bool> has_parent(nodes.size());
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const TCatalogue::NameIndex::Node &node = nodes[i];
+            CheckRange(node.label_begin, node.label_size, labels_size);
+            CheckRange(node.first_entry, node.entry_count, entries_size);
+            if (node.child_count == 0) {
+                continue;
+            }
+            if (node.first_child <= i) {
+                throw BaseFile::FormatError("Malformed base file name index");
+            }
+            CheckRange(node.first_child, node.child_count, nodes.size());
+            for (uint32_t child = node.first_child; child < node.first_child + node.child_count; ++child) {
+                if (has_parent[child] || nodes[child].label_size == 0) {
+                    throw BaseFile::FormatError("Malformed base file name index");
+                }
+                has_parent[child] = true;
+            }
+        }
+    }
+
+    // Расстояния по дорогам в номерах остановок, упорядоченные по from и to
+    std::vector<BaseFile::DistanceRecord> NumberDistances(const TCatalogue::TransportCatalogue &transportCatalogue,
+                                                          const BaseIds &ids) {
+        std::vector<BaseFile::DistanceRecord> result;
+        result.reserve(transportCatalogue.stops_pair_to_distance_.size());
+        for (const auto &[stops, distance]: transportCatalogue.stops_pair_to_distance_) {
+            // Ссылка на неизвестную остановку в исходных запросах
+            if (stops.first && stops.second) {
+                result.push_back({ids.stops.at(stops.first->name), ids.stops.at(stops.second->name), distance});
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const auto &lhs, const auto &rhs) {
+            return std::tie(lhs.from, lhs.to) < std::tie(rhs.from, rhs.to);
+        });
+        return result;
+    }
+
+    TCatalogue::ResponseFragments::Fragment CheckedFragment(std::string_view text, uint32_t split) {
+        if (split > text.size()) {
+            throw BaseFile::FormatError("Malformed base response fragment");
+        }
+        return {std::string(text), split};
+    }
+
+    void CheckHasDistances(bool has_distances) {
+        if (!has_distances) {
+            throw BaseFile::FormatError("Base has no road distances; rebuild it with make_base");
+        }
+    }
+
+}
+
+BaseIds NumberNames(const TCatalogue::TransportCatalogue &transportCatalogue) {
+    BaseIds ids;
+    for (const auto &[name, s]: transportCatalogue.ReturnAllStops()) {
+        ids.stops.emplace(name, static_cast<uint32_t>(ids.stops.size()));
+    }
+    for (const auto &[name, b]: transportCatalogue.ReturnAllBus()) {
+        ids.buses.emplace(name, static_cast<uint32_t>(ids.buses.size()));
+    }
+    return ids;
+}
+
+// Сообщение protobuf — последовательность полей, поэтому фрагменты с разными частями базы
+// кодируются независимо, а склеенные по порядку номеров полей совпадают байт в байт с кодированием
+// одного сообщения. Каждый фрагмент собирается на своей арене и кодируется своим потоком
 void Serialize(const TCatalogue::TransportCatalogue &TCatalog,
                const Render::MapRenderer &renderer, const TRouting::TRouter &router,
                std::ostream &output) {
-    serialization::TransportCatalogue database;
+    const BaseIds ids = NumberNames(TCatalog);
+    const auto distances = NumberDistances(TCatalog, ids);
+    std::vector<const TCatalogue::Stop *> stops;
+    stops.reserve(ids.stops.size());
     for (const auto &[name, s]: TCatalog.ReturnAllStops()) {
-        *database.add_stop() = Serialize(TCatalog, s);
+        stops.push_back(s);
     }
+    std::vector<const TCatalogue::Bus *> buses;
+    buses.reserve(ids.buses.size());
     for (const auto &[name, b]: TCatalog.ReturnAllBus()) {
-        *database.add_bus() = Serialize(b, TCatalog);
+        buses.push_back(b);
     }
-    *database.mutable_render_settings() = GetRenderSettingSerialize(renderer.GetRenderSetup());
-    *database.mutable_router() = Serialize(router);
-    database.SerializeToOstream(&output);
-}
 
-serialization::Stop Serialize(const TCatalogue::TransportCatalogue &transportCatalogue,
-                              const TCatalogue::Stop *stop) {
-    serialization::Stop result;
-    result.set_name(stop->name);
-    result.add_coordinate(stop->coordinates.lat);
-    result.add_coordinate(stop->coordinates.lng);
-    return result;
+    const size_t stop_chunks = (stops.size() + RECORDS_PER_CHUNK - 1) / RECORDS_PER_CHUNK;
+    const size_t bus_chunks = (buses.size() + RECORDS_PER_CHUNK - 1) / RECORDS_PER_CHUNK;
+    std::vector<std::string> chunks(stop_chunks + bus_chunks + static_cast<size_t>(TailChunk::COUNT));
+    Parallel::ForEachRange(chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            google::protobuf::Arena arena;
+            auto *chunk = google::protobuf::Arena::CreateMessage<serialization::TransportCatalogue>(&arena);
+            if (i < stop_chunks) {
+                const size_t first = i * RECORDS_PER_CHUNK;
+                const size_t last = std::min(first + RECORDS_PER_CHUNK, stops.size());
+                auto distance = std::lower_bound(distances.begin(), distances.end(), first,
+                                                 [](const auto &record, size_t id) { return record.from < id; });
+                chunk->mutable_stop()->Reserve(static_cast<int>(last - first));
+                for (size_t id = first; id < last; ++id) {
+                    serialization::Stop *stop = chunk->add_stop();
+                    Serialize(TCatalog, stops[id], stop);
+                    for (; distance != distances.end() && distance->from == id; ++distance) {
+                        stop->add_distance_to(distance->to);
+                        stop->add_distance(distance->distance);
+                    }
+                }
+            } else if (i < stop_chunks + bus_chunks) {
+                const size_t first = (i - stop_chunks) * RECORDS_PER_CHUNK;
+                const size_t last = std::min(first + RECORDS_PER_CHUNK, buses.size());
+                chunk->mutable_bus()->Reserve(static_cast<int>(last - first));
+                for (size_t id = first; id < last; ++id) {
+                    Serialize(buses[id], TCatalog, ids, chunk->add_bus());
+                }
+            } else {
+                switch (static_cast<TailChunk>(i - stop_chunks - bus_chunks)) {
+                    case TailChunk::RENDER_SETTINGS:
+                        chunk->mutable_render_settings()->CopyFrom(
+                                GetRenderSettingSerialize(renderer.GetRenderSetup()));
+                        break;
+                    case TailChunk::ROUTER:
+                        Serialize(router, ids, chunk->mutable_router());
+                        break;
+                    case TailChunk::NAME_INDEX:
+                        Serialize(TCatalog.GetNameIndex(), ids, chunk->mutable_name_index());
+                        break;
+                    case TailChunk::VERSION:
+                        chunk->set_version(PROTOBUF_VERSION);
+                        break;
+                    case TailChunk::MAP_JSON:
+                        chunk->set_map_json(std::string(renderer.GetBuiltMapJson()));
+                        break;
+                    case TailChunk::COUNT:
+                        break;
+                }
+            }
+            chunks[i] = chunk->SerializeAsString();
+        }
+    });
+    for (const auto &chunk: chunks) {
+        output.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    }
 }
 
+void Serialize(const TCatalogue::TransportCatalogue &transportCatalogue, const TCatalogue::Stop *stop,
+               serialization::Stop *result) {
+    result->set_name(stop->name);
+    result->add_coordinate(stop->coordinates.lat);
+    result->add_coordinate(stop->coordinates.lng);
+    if (const auto *fragment = transportCatalogue.GetResponseFragments().FindStop(stop->name)) {
+        result->set_response(fragment->text);
+        result->set_response_split(fragment->split);
+    }
+}
 
-serialization::Bus Serialize(const TCatalogue::Bus *bus, const TCatalogue::TransportCatalogue &transportCatalogue) {
 
-    serialization::Bus result;
-    result.set_name(bus->name);
+void Serialize(const TCatalogue::Bus *bus, const TCatalogue::TransportCatalogue &transportCatalogue,
+               const BaseIds &ids, serialization::Bus *result) {
+    result->set_name(bus->name);
+    result->mutable_stop_delta()->Reserve(static_cast<int>(bus->stops.size()));
+    int64_t previous = 0;
     for (const auto &s: bus->stops) {
-        result.add_stop(s->name);
+        const int64_t id = ids.stops.at(s->name);
+        result->add_stop_delta(static_cast<int32_t>(id - previous));
+        previous = id;
     }
-    result.set_is_circle(bus->is_loop);
+    result->set_is_circle(bus->is_loop);
 
     auto route_info = transportCatalogue.GetRouteInfo(bus->name);
-    result.set_stops_count(route_info.stops_count);
-    result.set_unique_stops(route_info.unique_stops);
-    result.set_road_lenght(route_info.road_lenght);
-    result.set_curvature(route_info.curvature);
-
-    return result;
+    result->set_stops_count(route_info.stops_count);
+    result->set_unique_stops(route_info.unique_stops);
+    result->set_road_lenght(route_info.road_lenght);
+    result->set_curvature(route_info.curvature);
+    if (const auto *fragment = transportCatalogue.GetResponseFragments().FindBus(bus->name)) {
+        result->set_response(fragment->text);
+        result->set_response_split(fragment->split);
+    }
 }
 
 serialization::Point GetPointSerialize(const Json::Array &p) {
@@ -71,7 +245,7 @@ serialization::Color GetColorSerialize(const Json::Node &node) {
             *result.mutable_rgba() = rgba;
         }
     } else if (node.IsString()) {
-        result.set_name(node.AsString());
+        result.set_name(std::string(node.AsString()));
     }
     return result;
 }
@@ -79,18 +253,18 @@ serialization::Color GetColorSerialize(const Json::Node &node) {
 serialization::RenderSettings GetRenderSettingSerialize(const Json::Node &render_settings) {
     const Json::Dict &rs_map = render_settings.AsDict();
     serialization::RenderSettings result;
-    result.set_width(rs_map.at("width"s).AsDouble());
-    result.set_height(rs_map.at("height"s).AsDouble());
-    result.set_padding(rs_map.at("padding"s).AsDouble());
-    result.set_stop_radius(rs_map.at("stop_radius"s).AsDouble());
-    result.set_line_width(rs_map.at("line_width"s).AsDouble());
-    result.set_bus_label_font_size(rs_map.at("bus_label_font_size"s).AsInt());
-    *result.mutable_bus_label_offset() = GetPointSerialize(rs_map.at("bus_label_offset"s).AsArray());
-    result.set_stop_label_font_size(rs_map.at("stop_label_font_size"s).AsInt());
-    *result.mutable_stop_label_offset() = GetPointSerialize(rs_map.at("stop_label_offset"s).AsArray());
-    *result.mutable_underlayer_color() = GetColorSerialize(rs_map.at("underlayer_color"s));
-    result.set_underlayer_width(rs_map.at("underlayer_width"s).AsDouble());
-    for (const auto &c: rs_map.at("color_palette"s).AsArray()) {
+    result.set_width(rs_map.at("width").AsDouble());
+    result.set_height(rs_map.at("height").AsDouble());
+    result.set_padding(rs_map.at("padding").AsDouble());
+    result.set_stop_radius(rs_map.at("stop_radius").AsDouble());
+    result.set_line_width(rs_map.at("line_width").AsDouble());
+    result.set_bus_label_font_size(rs_map.at("bus_label_font_size").AsInt());
+    *result.mutable_bus_label_offset() = GetPointSerialize(rs_map.at("bus_label_offset").AsArray());
+    result.set_stop_label_font_size(rs_map.at("stop_label_font_size").AsInt());
+    *result.mutable_stop_label_offset() = GetPointSerialize(rs_map.at("stop_label_offset").AsArray());
+    *result.mutable_underlayer_color() = GetColorSerialize(rs_map.at("underlayer_color"));
+    result.set_underlayer_width(rs_map.at("underlayer_width").AsDouble());
+    for (const auto &c: rs_map.at("color_palette").AsArray()) {
         *result.add_color_palette() = GetColorSerialize(c);
     }
     return result;
@@ -99,68 +273,268 @@ serialization::RenderSettings GetRenderSettingSerialize(const Json::Node &render
 serialization::RouterSettings GetRouterSettingSerialize(const Json::Node &router_settings) {
     const Json::Dict &rs_map = router_settings.AsDict();
     serialization::RouterSettings result;
-    result.set_bus_wait_time(rs_map.at("bus_wait_time"s).AsInt());
-    result.set_bus_velocity(rs_map.at("bus_velocity"s).AsDouble());
+    result.set_bus_wait_time(rs_map.at("bus_wait_time").AsInt());
+    result.set_bus_velocity(rs_map.at("bus_velocity").AsDouble());
     return result;
 }
 
-serialization::Graph GetGraphSerialize(const graph::DirectedWeightedGraph<double> &g) {
-    serialization::Graph result;
-    size_t vertex_count = g.GetVertexCount();
-    size_t edge_count = g.GetEdgeCount();
+// Длина поездки, по которой TRouter::RideTime восстанавливает вес ребра в точности
+std::optional<uint32_t> RideLength(const graph::Edge<double> &edge, const serialization::RouterSettings &settings) {
+    if (edge.span == 0) {
+        return edge.weight == settings.bus_wait_time() ? std::optional<uint32_t>(0) : std::nullopt;
+    }
+    const double length = std::round(edge.weight * settings.bus_velocity() * (1000.0 / 60.0));
+    if (!(length >= 0.0 && length <= std::numeric_limits<int>::max())
+        || TRouting::TRouter::RideTime(static_cast<int>(length), settings.bus_velocity()) != edge.weight) {
+        return std::nullopt;
+    }
+    return static_cast<uint32_t>(length);
+}
+
+void GetGraphSerialize(const graph::DirectedWeightedGraph<double> &g, const serialization::RouterSettings &settings,
+                       const BaseIds &ids, serialization::Graph *result) {
+    const size_t edge_count = g.GetEdgeCount();
+    const auto reserved = static_cast<int>(edge_count);
+    result->mutable_edge_from()->Reserve(reserved);
+    result->mutable_edge_to()->Reserve(reserved);
+    result->mutable_edge_span()->Reserve(reserved);
+    result->mutable_edge_owner()->Reserve(reserved);
+    result->mutable_edge_length()->Reserve(reserved);
+    bool exact_lengths = true;
     for (size_t i = 0; i < edge_count; ++i) {
         const graph::Edge<double> &edge = g.GetEdge(i);
-        serialization::Edge s_edge;
-        s_edge.set_name(edge.name);
-        s_edge.set_quality(edge.span);
-        s_edge.set_from(edge.from);
-        s_edge.set_to(edge.to);
-        s_edge.set_weight(edge.weight);
-        *result.add_edge() = s_edge;
+        result->add_edge_from(edge.from);
+        result->add_edge_to(edge.to);
+        result->add_edge_span(edge.span);
+        result->add_edge_owner(edge.span == 0 ? ids.stops.at(edge.name) : ids.buses.at(edge.name));
+        if (exact_lengths) {
+            if (const auto length = RideLength(edge, settings)) {
+                result->add_edge_length(*length);
+            } else {
+                exact_lengths = false;
+                result->clear_edge_length();
+            }
+        }
     }
-    for (size_t i = 0; i < vertex_count; ++i) {
-        serialization::Vertex vertex;
-        for (const auto &edge_id: g.GetIncidentEdges(i)) {
-            vertex.add_edge_id(edge_id);
+    if (!exact_lengths) {
+        result->mutable_edge_weight()->Reserve(reserved);
+        for (size_t i = 0; i < edge_count; ++i) {
+            result->add_edge_weight(g.GetEdge(i).weight);
         }
-        *result.add_vertex() = vertex;
     }
-    return result;
 }
 
-serialization::Router Serialize(const TRouting::TRouter &router) {
-    serialization::Router result;
-    *result.mutable_router_settings() = GetRouterSettingSerialize(router.GetBusSettings());
-    *result.mutable_graph() = GetGraphSerialize(router.GetGraph());
+void Serialize(const TRouting::TRouter &router, const BaseIds &ids, serialization::Router *result) {
+    result->mutable_router_settings()->CopyFrom(GetRouterSettingSerialize(router.GetBusSettings()));
+    GetGraphSerialize(router.GetGraph(), result->router_settings(), ids, result->mutable_graph());
+    // Остановки в GetStopIds упорядочены по названию, как и в базе
+    result->mutable_stop_vertex()->Reserve(static_cast<int>(router.GetStopIds().size()));
     for (const auto &[n, id]: router.GetStopIds()) {
-        serialization::StopId si;
-        si.set_name(n);
-        si.set_id(id);
-        *result.add_stop_id() = si;
+        result->add_stop_vertex(static_cast<uint32_t>(id));
+    }
+}
+
+void Serialize(const TCatalogue::NameIndex &index, const BaseIds &ids, serialization::NameIndex *result) {
+    const auto &stop_ids = ids.stops;
+    const auto &bus_ids = ids.buses;
+    result->set_labels(index.GetLabels());
+    result->mutable_node()->Reserve(static_cast<int>(index.GetNodes().size()));
+    for (const auto &node: index.GetNodes()) {
+        serialization::NameIndexNode *s_node = result->add_node();
+        s_node->set_label_begin(node.label_begin);
+        s_node->set_label_size(node.label_size);
+        s_node->set_first_child(node.first_child);
+        s_node->set_child_count(node.child_count);
+        s_node->set_first_entry(node.first_entry);
+        s_node->set_entry_count(node.entry_count);
+    }
+    result->mutable_entry()->Reserve(static_cast<int>(index.GetEntries().size()));
+    for (const auto &entry: index.GetEntries()) {
+        serialization::NameIndexEntry *s_entry = result->add_entry();
+        const bool is_bus = entry.kind == TCatalogue::NameIndex::Kind::BUS;
+        s_entry->set_is_bus(is_bus);
+        s_entry->set_id(is_bus ? bus_ids.at(entry.name) : stop_ids.at(entry.name));
     }
-    return result;
 }
 
-void
-AddStopFromDB(TCatalogue::TransportCatalogue &transportCatalogue, const serialization::TransportCatalogue &database) {
-    for (size_t i = 0; i < database.stop_size(); ++i) {
-        const serialization::Stop &stop_i = database.stop(i);
-        transportCatalogue.AddStop(stop_i.name(), {stop_i.coordinate(0), stop_i.coordinate(1)});
+namespace {
+
+    // Байтов protobuf в одном фрагменте, разбираемом отдельным потоком
+    constexpr size_t PARSE_CHUNK_BYTES = 1 << 18;
+    // Маршрутов, остановки которых восстанавливает один поток
+    constexpr size_t BUSES_PER_BLOCK = 256;
+
+    // Части базы, собранные из одного или нескольких разобранных фрагментов
+    struct BaseMessages {
+        std::vector<const serialization::Stop *> stops;
+        std::vector<const serialization::Bus *> buses;
+        const serialization::RenderSettings *render_settings = &serialization::RenderSettings::default_instance();
+        const serialization::Router *router = &serialization::Router::default_instance();
+        const serialization::NameIndex *name_index = &serialization::NameIndex::default_instance();
+        const std::string *map_json = nullptr;
+        uint32_t version = 0;
+
+        void Add(const serialization::TransportCatalogue &part) {
+            for (const auto &stop: part.stop()) {
+                stops.push_back(&stop);
+            }
+            for (const auto &bus: part.bus()) {
+                buses.push_back(&bus);
+            }
+            if (part.has_render_settings()) {
+                render_settings = &part.render_settings();
+            }
+            if (part.has_router()) {
+                router = &part.router();
+            }
+            if (part.has_name_index()) {
+                name_index = &part.name_index();
+            }
+            if (part.version() != 0) {
+                version = part.version();
+            }
+            if (!part.map_json().empty()) {
+                map_json = &part.map_json();
+            }
+        }
+    };
+
+    bool ReadVarint(std::string_view &data, uint64_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && !data.empty(); shift += 7) {
+            const auto byte = static_cast<uint8_t>(data.front());
+            data.remove_prefix(1);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
     }
+
+    bool SkipField(std::string_view &data) {
+        uint64_t tag;
+        uint64_t size;
+        if (!ReadVarint(data, tag)) {
+            return false;
+        }
+        switch (tag & 7) {
+            case 0:
+                return ReadVarint(data, size);
+            case 1:
+                size = 8;
+                break;
+            case 2:
+                if (!ReadVarint(data, size)) {
+                    return false;
+                }
+                break;
+            case 5:
+                size = 4;
+                break;
+            default:
+                return false;
+        }
+        if (size > data.size()) {
+            return false;
+        }
+        data.remove_prefix(size);
+        return true;
+    }
+
+    // Делит сообщение по границам полей верхнего уровня на фрагменты около PARSE_CHUNK_BYTES:
+    // каждый фрагмент сам по себе — сообщение TransportCatalogue. Если разметку прочитать
+    // не удалось, сообщение остаётся одним фрагментом и ошибку сообщит protobuf
+    std::vector<std::string_view> SplitFields(std::string_view data) {
+        std::vector<std::string_view> chunks;
+        std::string_view rest = data;
+        const char *chunk_begin = data.data();
+        while (!rest.empty()) {
+            if (!SkipField(rest)) {
+                return {data};
+            }
+            if (static_cast<size_t>(rest.data() - chunk_begin) >= PARSE_CHUNK_BYTES || rest.empty()) {
+                chunks.emplace_back(chunk_begin, static_cast<size_t>(rest.data() - chunk_begin));
+                chunk_begin = rest.data();
+            }
+        }
+        return chunks;
+    }
+
+    // Фрагменты разбираются параллельно; сообщения живут на arena
+    BaseMessages ParseChunks(std::string_view data, google::protobuf::Arena &arena) {
+        if (data.size() > static_cast<size_t>(std::numeric_limits<int>::max())) {
+            throw BaseFile::FormatError("Base file is too large for protobuf");
+        }
+        const std::vector<std::string_view> chunks = SplitFields(data);
+        std::vector<serialization::TransportCatalogue *> parts(chunks.size());
+        Parallel::ForEachRange(chunks.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                parts[i] = google::protobuf::Arena::CreateMessage<serialization::TransportCatalogue>(&arena);
+                if (!parts[i]->ParseFromArray(chunks[i].data(), static_cast<int>(chunks[i].size()))) {
+                    throw BaseFile::FormatError("Malformed protobuf base file");
+                }
+            }
+        });
+        BaseMessages messages;
+        for (const auto *part: parts) {
+            messages.Add(*part);
+        }
+        return messages;
+    }
+
 }
 
-void
-AddBusFromDB(TCatalogue::TransportCatalogue &transportCatalogue, const serialization::TransportCatalogue &database) {
-    for (size_t i = 0; i < database.bus_size(); ++i) {
-        const serialization::Bus &bus_i = database.bus(i);
-        std::vector<std::string> stops(bus_i.stop_size());
-        for (size_t j = 0; j < stops.size(); ++j) {
-            stops[j] = transportCatalogue.FindStop(bus_i.stop(j))->name;
+std::vector<const TCatalogue::Stop *>
+AddStopFromDB(TCatalogue::TransportCatalogue &transportCatalogue, const BaseMessages &database) {
+    std::vector<const TCatalogue::Stop *> result;
+    result.reserve(database.stops.size());
+    for (const serialization::Stop *stop_i: database.stops) {
+        if (stop_i->coordinate_size() != 2) {
+            throw BaseFile::FormatError("Malformed protobuf base stop");
         }
-        transportCatalogue.AddBusFromDb(bus_i.name(), stops, bus_i.is_circle(),
-                                        {static_cast<int>(bus_i.stops_count()), static_cast<int>(bus_i.unique_stops()),
-                                         bus_i.road_lenght(), bus_i.curvature()});
+        result.push_back(transportCatalogue.AddStop(stop_i->name(), {stop_i->coordinate(0), stop_i->coordinate(1)}));
     }
+    return result;
+}
+
+// all_stops — остановки в порядке базы, на них ссылаются номера версии 2. Остановки маршрутов
+// восстанавливаются параллельно, сами маршруты добавляются в справочник по порядку
+std::vector<const TCatalogue::Bus *>
+AddBusFromDB(TCatalogue::TransportCatalogue &transportCatalogue, const BaseMessages &database,
+             const std::vector<const TCatalogue::Stop *> &all_stops) {
+    std::vector<std::vector<const TCatalogue::Stop *>> routes(database.buses.size());
+    Parallel::ForEachRange(routes.size(), BUSES_PER_BLOCK, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const serialization::Bus &bus_i = *database.buses[i];
+            std::vector<const TCatalogue::Stop *> &stops = routes[i];
+            if (database.version >= 2) {
+                stops.reserve(bus_i.stop_delta_size());
+                int64_t id = 0;
+                for (const int32_t delta: bus_i.stop_delta()) {
+                    id += delta;
+                    CheckIndex(static_cast<uint64_t>(id), all_stops.size());
+                    stops.push_back(all_stops[id]);
+                }
+            } else {
+                stops.resize(bus_i.stop_size());
+                for (size_t j = 0; j < stops.size(); ++j) {
+                    stops[j] = transportCatalogue.FindStop(bus_i.stop(j));
+                }
+            }
+        }
+    });
+
+    std::vector<const TCatalogue::Bus *> result;
+    result.reserve(routes.size());
+    for (size_t i = 0; i < routes.size(); ++i) {
+        const serialization::Bus &bus_i = *database.buses[i];
+        result.push_back(transportCatalogue.AddBusFromDb(
+                bus_i.name(), std::move(routes[i]), bus_i.is_circle(),
+                {static_cast<int>(bus_i.stops_count()), static_cast<int>(bus_i.unique_stops()),
+                 bus_i.road_lenght(), bus_i.curvature()}));
+    }
+    return result;
 }
 
 Json::Node ToNode(const serialization::Point &p) {
@@ -195,39 +569,41 @@ Json::Node ToNode(const google::protobuf::RepeatedPtrField<serialization::Color>
     return Json::Node(std::move(result));
 }
 
-Json::Node GetRenderSettingsFromDB(const serialization::TransportCatalogue &database) {
-    const serialization::RenderSettings &rs = database.render_settings();
+Json::Node GetRenderSettingsFromDB(const serialization::RenderSettings &rs) {
     return Json::Node(Json::Dict{
-            {{"width"s},                {rs.width()}},
-            {{"height"s},               {rs.height()}},
-            {{"padding"s},              {rs.padding()}},
-            {{"stop_radius"s},          {rs.stop_radius()}},
-            {{"line_width"s},           {rs.line_width()}},
-            {{"bus_label_font_size"s},  {rs.bus_label_font_size()}},
-            {{"bus_label_offset"s},     ToNode(rs.bus_label_offset())},
-            {{"stop_label_font_size"s}, {rs.stop_label_font_size()}},
-            {{"stop_label_offset"s},    ToNode(rs.stop_label_offset())},
-            {{"underlayer_color"s},     ToNode(rs.underlayer_color())},
-            {{"underlayer_width"s},     {rs.underlayer_width()}},
-            {{"color_palette"s},        ToNode(rs.color_palette())},
+            {"width",                {rs.width()}},
+            {"height",               {rs.height()}},
+            {"padding",              {rs.padding()}},
+            {"stop_radius",          {rs.stop_radius()}},
+            {"line_width",           {rs.line_width()}},
+            {"bus_label_font_size",  {rs.bus_label_font_size()}},
+            {"bus_label_offset",     ToNode(rs.bus_label_offset())},
+            {"stop_label_font_size", {rs.stop_label_font_size()}},
+            {"stop_label_offset",    ToNode(rs.stop_label_offset())},
+            {"underlayer_color",     ToNode(rs.underlayer_color())},
+            {"underlayer_width",     {rs.underlayer_width()}},
+            {"color_palette",        ToNode(rs.color_palette())},
     });
 }
 
-Json::Node GetRouterSettingsFromDB(const serialization::Router &router) {
-    const serialization::RouterSettings &rs = router.router_settings();
+Json::Node GetRouterSettingsFromDB(const serialization::RouterSettings &rs) {
     return Json::Node(Json::Dict{
-            {{"bus_wait_time"s}, {rs.bus_wait_time()}},
-            {{"bus_velocity"s},  {rs.bus_velocity()}}
+            {"bus_wait_time", {rs.bus_wait_time()}},
+            {"bus_velocity",  {rs.bus_velocity()}}
     });
 }
 
-graph::DirectedWeightedGraph<double> GetGraphFromDB(const serialization::Router &router) {
+// Названия рёбер берутся из справочника: граф не хранит собственных копий строк
+graph::DirectedWeightedGraph<double> GetGraphFromDB(const serialization::Router &router,
+                                                    const TCatalogue::TransportCatalogue &transportCatalogue) {
     const serialization::Graph &g = router.graph();
     std::vector<graph::Edge<double>> edges(g.edge_size());
     std::vector<std::vector<graph::EdgeId>> incidence_lists(g.vertex_size());
     for (size_t i = 0; i < edges.size(); ++i) {
         const serialization::Edge &edg = g.edge(i);
-        edges[i] = {edg.name(), static_cast<size_t>(edg.quality()),
+        const std::string_view name = edg.quality() == 0 ? transportCatalogue.FindStop(edg.name())->name
+                                                         : transportCatalogue.GetBusInfo(edg.name())->name;
+        edges[i] = {name, static_cast<size_t>(edg.quality()),
                     static_cast<size_t>(edg.from()), static_cast<size_t>(edg.to()), edg.weight()};
     }
     for (size_t i = 0; i < incidence_lists.size(); ++i) {
@@ -240,25 +616,542 @@ graph::DirectedWeightedGraph<double> GetGraphFromDB(const serialization::Router
     return {edges, incidence_lists};
 }
 
+// Граф версии 2: у каждой остановки две вершины, как в TRouter::MakeRoute. Списки смежности
+// собираются в порядке номеров рёбер — так же, как их заполняет AddEdge
+graph::DirectedWeightedGraph<double> GetGraphFromColumns(const serialization::Router &router,
+                                                         const std::vector<const TCatalogue::Stop *> &stops,
+                                                         const std::vector<const TCatalogue::Bus *> &buses) {
+    const serialization::Graph &g = router.graph();
+    const int edge_count = g.edge_from_size();
+    const bool has_lengths = g.edge_length_size() == edge_count;
+    if (g.edge_to_size() != edge_count || g.edge_span_size() != edge_count || g.edge_owner_size() != edge_count
+        || (!has_lengths && g.edge_weight_size() != edge_count)) {
+        throw BaseFile::FormatError("Malformed protobuf base graph");
+    }
+    const double wait_time = router.router_settings().bus_wait_time();
+    const double velocity = router.router_settings().bus_velocity();
+
+    const size_t vertex_count = stops.size() * 2;
+    std::vector<graph::Edge<double>> edges;
+    edges.reserve(edge_count);
+    std::vector<std::vector<graph::EdgeId>> incidence_lists(vertex_count);
+    for (int i = 0; i < edge_count; ++i) {
+        const uint32_t from = g.edge_from(i);
+        const uint32_t to = g.edge_to(i);
+        const uint32_t span = g.edge_span(i);
+        const uint32_t owner = g.edge_owner(i);
+        CheckIndex(from, vertex_count);
+        CheckIndex(to, vertex_count);
+        CheckIndex(owner, span == 0 ? stops.size() : buses.size());
+        double weight;
+        if (!has_lengths) {
+            weight = g.edge_weight(i);
+        } else if (span == 0) {
+            weight = wait_time;
+        } else {
+            CheckIndex(g.edge_length(i), static_cast<uint64_t>(std::numeric_limits<int>::max()) + 1);
+            weight = TRouting::TRouter::RideTime(static_cast<int>(g.edge_length(i)), velocity);
+        }
+        const std::string_view name = span == 0 ? stops[owner]->name : buses[owner]->name;
+        edges.push_back({name, span, from, to, weight});
+        incidence_lists[from].push_back(static_cast<graph::EdgeId>(i));
+    }
+    return {std::move(edges), std::move(incidence_lists)};
+}
+
 std::map<std::string, graph::VertexId> GetStopIdsFromDB(const serialization::Router &router) {
     std::map<std::string, graph::VertexId> result;
     for (const auto &s: router.stop_id()) {
+        CheckIndex(s.id(), router.graph().vertex_size());
         result[s.name()] = s.id();
     }
     return result;
 }
 
-std::tuple<TCatalogue::TransportCatalogue, Render::MapRenderer, TRouting::TRouter,
-        graph::DirectedWeightedGraph<double>, std::map<std::string, graph::VertexId>>
-Deserialize(std::istream &input) {
-    serialization::TransportCatalogue database;
-    database.ParseFromIstream(&input);
+std::map<std::string, graph::VertexId> GetStopVerticesFromDB(const serialization::Router &router,
+                                                             const std::vector<const TCatalogue::Stop *> &stops) {
+    if (static_cast<size_t>(router.stop_vertex_size()) != stops.size()) {
+        throw BaseFile::FormatError("Malformed protobuf base graph");
+    }
+    std::map<std::string, graph::VertexId> result;
+    // У каждой остановки две вершины, как в GetGraphFromColumns
+    for (size_t i = 0; i < stops.size(); ++i) {
+        CheckIndex(router.stop_vertex(i), stops.size() * 2);
+        result.emplace_hint(result.end(), stops[i]->name, router.stop_vertex(i));
+    }
+    return result;
+}
+
+TCatalogue::NameIndex GetNameIndexFromDB(const serialization::NameIndex &index,
+                                         const std::vector<const TCatalogue::Stop *> &stops,
+                                         const std::vector<const TCatalogue::Bus *> &buses) {
+    std::vector<TCatalogue::NameIndex::Node> nodes(index.node_size());
+    std::vector<TCatalogue::NameIndex::Entry> entries(index.entry_size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const serialization::NameIndexNode &node = index.node(i);
+        nodes[i] = {node.label_begin(), node.label_size(), node.first_child(), node.child_count(),
+                    node.first_entry(), node.entry_count()};
+    }
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const serialization::NameIndexEntry &entry = index.entry(i);
+        if (entry.is_bus()) {
+            CheckIndex(entry.id(), buses.size());
+            entries[i] = {buses[entry.id()]->name, TCatalogue::NameIndex::Kind::BUS};
+        } else {
+            CheckIndex(entry.id(), stops.size());
+            entries[i] = {stops[entry.id()]->name, TCatalogue::NameIndex::Kind::STOP};
+        }
+    }
+    CheckNameIndex(nodes, index.labels().size(), entries.size());
+    return {index.labels(), std::move(nodes), std::move(entries)};
+}
+
+TCatalogue::ResponseFragments GetResponsesFromDB(const BaseMessages &database,
+                                                 const std::vector<const TCatalogue::Stop *> &stops,
+                                                 const std::vector<const TCatalogue::Bus *> &buses) {
+    TCatalogue::ResponseFragments result;
+    for (size_t i = 0; i < stops.size(); ++i) {
+        const serialization::Stop &stop_i = *database.stops[i];
+        if (!stop_i.response().empty()) {
+            result.AddStop(stops[i]->name, CheckedFragment(stop_i.response(), stop_i.response_split()));
+        }
+    }
+    for (size_t i = 0; i < buses.size(); ++i) {
+        const serialization::Bus &bus_i = *database.buses[i];
+        if (!bus_i.response().empty()) {
+            result.AddBus(buses[i]->name, CheckedFragment(bus_i.response(), bus_i.response_split()));
+        }
+    }
+    return result;
+}
+
+void AddDistancesFromDB(TCatalogue::TransportCatalogue &transportCatalogue,
+                        const BaseMessages &database,
+                        const std::vector<const TCatalogue::Stop *> &stops) {
+    CheckHasDistances(database.version >= 3);
+    for (size_t i = 0; i < stops.size(); ++i) {
+        const serialization::Stop &stop_i = *database.stops[i];
+        if (stop_i.distance_to_size() != stop_i.distance_size()) {
+            throw BaseFile::FormatError("Malformed protobuf base distances");
+        }
+        for (int j = 0; j < stop_i.distance_to_size(); ++j) {
+            CheckIndex(stop_i.distance_to(j), stops.size());
+            transportCatalogue.SetDistanseToTwoStops(stops[i], stops[stop_i.distance_to(j)], stop_i.distance(j));
+        }
+    }
+}
+
+// Справочник заполняется по порядку, а независимые друг от друга граф, индекс названий
+// и готовые ответы восстанавливаются параллельно
+DeserializedBase Deserialize(const BaseMessages &database, bool with_distances) {
+    TCatalogue::TransportCatalogue catalogue;
+    Render::MapRenderer renderer(GetRenderSettingsFromDB(*database.render_settings));
+    TRouting::TRouter router(GetRouterSettingsFromDB(database.router->router_settings()));
+    if (database.version > PROTOBUF_VERSION) {
+        throw BaseFile::FormatError("Unsupported protobuf base version " + std::to_string(database.version));
+    }
+    const auto stops = AddStopFromDB(catalogue, database);
+    if (with_distances) {
+        AddDistancesFromDB(catalogue, database, stops);
+    }
+    const auto buses = AddBusFromDB(catalogue, database, stops);
+
+    graph::DirectedWeightedGraph<double> graph;
+    std::map<std::string, graph::VertexId> stop_ids;
+    TCatalogue::NameIndex name_index;
+    TCatalogue::ResponseFragments responses;
+    Parallel::ForEachRange(3, 1, [&](size_t begin, size_t end) {
+        for (size_t task = begin; task < end; ++task) {
+            if (task == 2) {
+                responses = GetResponsesFromDB(database, stops, buses);
+            } else if (task == 1) {
+                name_index = GetNameIndexFromDB(*database.name_index, stops, buses);
+            } else if (database.version >= 2) {
+                graph = GetGraphFromColumns(*database.router, stops, buses);
+                stop_ids = GetStopVerticesFromDB(*database.router, stops);
+            } else {
+                graph = GetGraphFromDB(*database.router, catalogue);
+                stop_ids = GetStopIdsFromDB(*database.router);
+            }
+        }
+    });
+    catalogue.SetNameIndex(std::move(name_index));
+    catalogue.SetResponseFragments(std::move(responses));
+    if (database.map_json) {
+        renderer.SetMapJson(*database.map_json);
+    }
+    return {std::move(catalogue), std::move(renderer), std::move(router), std::move(graph), std::move(stop_ids)};
+}
+
+DeserializedBase Deserialize(const serialization::TransportCatalogue &database, bool with_distances) {
+    BaseMessages messages;
+    messages.Add(database);
+    return Deserialize(messages, with_distances);
+}
+
+DeserializedBase Deserialize(std::istream &input, bool with_distances) {
+    const std::string data{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+    google::protobuf::Arena arena;
+    return Deserialize(ParseChunks(data, arena), with_distances);
+}
+
+void SerializeMapped(const TCatalogue::TransportCatalogue &TCatalog,
+                     const Render::MapRenderer &renderer, const TRouting::TRouter &router,
+                     std::ostream &output) {
+    BaseFile::Writer writer;
+    BaseFile::StringTable strings;
+
+    const BaseIds ids = NumberNames(TCatalog);
+    const auto &stop_ids = ids.stops;
+    const auto &bus_ids = ids.buses;
+
+    std::vector<BaseFile::StopRecord> stops;
+    std::vector<uint32_t> stop_vertices;
+    for (const auto &[name, stop]: TCatalog.ReturnAllStops()) {
+        stops.push_back({strings.Add(name), stop->coordinates.lat, stop->coordinates.lng});
+        stop_vertices.push_back(static_cast<uint32_t>(router.GetStopIds().at(stop->name)));
+    }
+
+    std::vector<BaseFile::BusRecord> buses;
+    std::vector<uint32_t> bus_stops;
+    for (const auto &[name, bus]: TCatalog.ReturnAllBus()) {
+        const TCatalogue::BusRouteInfo info = TCatalog.GetRouteInfo(name);
+        BaseFile::BusRecord record;
+        record.name = strings.Add(name);
+        record.first_stop = static_cast<uint32_t>(bus_stops.size());
+        record.stop_count = static_cast<uint32_t>(bus->stops.size());
+        record.stops_count = info.stops_count;
+        record.unique_stops = info.unique_stops;
+        record.is_loop = bus->is_loop;
+        record.road_length = info.road_lenght;
+        record.curvature = info.curvature;
+        buses.push_back(record);
+        for (const TCatalogue::Stop *stop: bus->stops) {
+            bus_stops.push_back(stop_ids.at(stop->name));
+        }
+    }
+
+    // Рёбра, списки смежности, индекс названий и расстояния кодируются параллельно
+    const auto &graph = router.GetGraph();
+    const TCatalogue::NameIndex &index = TCatalog.GetNameIndex();
+    std::vector<BaseFile::EdgeRecord> edges;
+    std::vector<uint32_t> incidence_offsets{0};
+    std::vector<uint32_t> incidence_edges;
+    std::vector<BaseFile::NameIndexEntryRecord> index_entries;
+    std::vector<BaseFile::DistanceRecord> distances;
+    Parallel::ForEachRange(4, 1, [&](size_t begin, size_t end) {
+        for (size_t task = begin; task < end; ++task) {
+            if (task == 0) {
+                edges.reserve(graph.GetEdgeCount());
+                for (size_t i = 0; i < graph.GetEdgeCount(); ++i) {
+                    const graph::Edge<double> &edge = graph.GetEdge(i);
+                    edges.push_back({static_cast<uint32_t>(edge.from), static_cast<uint32_t>(edge.to),
+                                     static_cast<uint32_t>(edge.span),
+                                     edge.span == 0 ? stop_ids.at(edge.name) : bus_ids.at(edge.name), edge.weight});
+                }
+            } else if (task == 1) {
+                incidence_edges.reserve(graph.GetEdgeCount());
+                for (size_t vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+                    for (const graph::EdgeId edge_id: graph.GetIncidentEdges(vertex)) {
+                        incidence_edges.push_back(static_cast<uint32_t>(edge_id));
+                    }
+                    incidence_offsets.push_back(static_cast<uint32_t>(incidence_edges.size()));
+                }
+            } else if (task == 2) {
+                index_entries.reserve(index.GetEntries().size());
+                for (const auto &entry: index.GetEntries()) {
+                    const bool is_bus = entry.kind == TCatalogue::NameIndex::Kind::BUS;
+                    index_entries.push_back({is_bus, is_bus ? bus_ids.at(entry.name) : stop_ids.at(entry.name)});
+                }
+            } else {
+                distances = NumberDistances(TCatalog, ids);
+            }
+        }
+    });
+
+    writer.AddSection(BaseFile::SectionId::STRINGS, strings.GetData());
+    writer.AddSection(BaseFile::SectionId::STOPS, stops);
+    writer.AddSection(BaseFile::SectionId::BUSES, buses);
+    writer.AddSection(BaseFile::SectionId::BUS_STOPS, bus_stops);
+    writer.AddSection(BaseFile::SectionId::STOP_VERTICES, stop_vertices);
+    writer.AddSection(BaseFile::SectionId::EDGES, edges);
+    writer.AddSection(BaseFile::SectionId::INCIDENCE_OFFSETS, incidence_offsets);
+    writer.AddSection(BaseFile::SectionId::INCIDENCE_EDGES, incidence_edges);
+    // Небольшие настройки хранятся их сообщениями protobuf
+    writer.AddSection(BaseFile::SectionId::ROUTER_SETTINGS,
+                      GetRouterSettingSerialize(router.GetBusSettings()).SerializeAsString());
+    writer.AddSection(BaseFile::SectionId::RENDER_SETTINGS,
+                      GetRenderSettingSerialize(renderer.GetRenderSetup()).SerializeAsString());
+    writer.AddSection(BaseFile::SectionId::NAME_INDEX_LABELS, index.GetLabels());
+    writer.AddSection(BaseFile::SectionId::NAME_INDEX_NODES, index.GetNodes());
+    writer.AddSection(BaseFile::SectionId::NAME_INDEX_ENTRIES, index_entries);
+    writer.AddSection(BaseFile::SectionId::ROAD_DISTANCES, distances);
+
+    // Готовые ответы пишутся, только если они построены
+    const TCatalogue::ResponseFragments &fragments = TCatalog.GetResponseFragments();
+    if (!fragments.Empty()) {
+        BaseFile::StringTable response_text;
+        auto add_response = [&response_text](const TCatalogue::ResponseFragments::Fragment *fragment) {
+            return fragment ? BaseFile::ResponseRecord{response_text.Add(fragment->text), fragment->split}
+                            : BaseFile::ResponseRecord{};
+        };
+        std::vector<BaseFile::ResponseRecord> stop_responses;
+        stop_responses.reserve(stop_ids.size());
+        for (const auto &[name, stop]: TCatalog.ReturnAllStops()) {
+            stop_responses.push_back(add_response(fragments.FindStop(name)));
+        }
+        std::vector<BaseFile::ResponseRecord> bus_responses;
+        bus_responses.reserve(bus_ids.size());
+        for (const auto &[name, bus]: TCatalog.ReturnAllBus()) {
+            bus_responses.push_back(add_response(fragments.FindBus(name)));
+        }
+        writer.AddSection(BaseFile::SectionId::RESPONSE_TEXT, response_text.GetData());
+        writer.AddSection(BaseFile::SectionId::STOP_RESPONSES, stop_responses);
+        writer.AddSection(BaseFile::SectionId::BUS_RESPONSES, bus_responses);
+    }
+    if (const std::string_view map_json = renderer.GetBuiltMapJson(); !map_json.empty()) {
+        writer.AddSection(BaseFile::SectionId::MAP_JSON, std::string(map_json));
+    }
+    writer.Write(output);
+}
+
+namespace {
+
+    template<typename Message>
+    Message ParseSection(std::string_view bytes) {
+        Message message;
+        if (!message.ParseFromArray(bytes.data(), static_cast<int>(bytes.size()))) {
+            throw BaseFile::FormatError("Malformed base file settings");
+        }
+        return message;
+    }
+
+}
+
+TCatalogue::NameIndex GetNameIndexFromMapped(const BaseFile::View &base,
+                                             const std::vector<const TCatalogue::Stop *> &stops,
+                                             const std::vector<const TCatalogue::Bus *> &buses) {
+    using BaseFile::SectionId;
+    std::vector<TCatalogue::NameIndex::Node> index_nodes;
+    for (const auto &node: base.Records<TCatalogue::NameIndex::Node>(SectionId::NAME_INDEX_NODES)) {
+        index_nodes.push_back(node);
+    }
+    std::vector<TCatalogue::NameIndex::Entry> index_entries;
+    for (const auto &entry: base.Records<BaseFile::NameIndexEntryRecord>(SectionId::NAME_INDEX_ENTRIES)) {
+        if (entry.is_bus) {
+            CheckIndex(entry.id, buses.size());
+            index_entries.push_back({buses[entry.id]->name, TCatalogue::NameIndex::Kind::BUS});
+        } else {
+            CheckIndex(entry.id, stops.size());
+            index_entries.push_back({stops[entry.id]->name, TCatalogue::NameIndex::Kind::STOP});
+        }
+    }
+    const std::string_view labels = base.Bytes(SectionId::NAME_INDEX_LABELS);
+    CheckNameIndex(index_nodes, labels.size(), index_entries.size());
+    return {std::string(labels), std::move(index_nodes), std::move(index_entries)};
+}
+
+// Пустая запись — ответа для остановки или маршрута нет
+template<typename Add>
+void AddResponsesFromMapped(const BaseFile::View &base, BaseFile::SectionId section, size_t count, Add add) {
+    const std::string_view text = base.Bytes(BaseFile::SectionId::RESPONSE_TEXT);
+    const auto records = base.Records<BaseFile::ResponseRecord>(section);
+    if (records.size() != count) {
+        throw BaseFile::FormatError("Malformed base file reference");
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const BaseFile::StringRef ref = records[i].text;
+        if (ref.size == 0) {
+            continue;
+        }
+        if (static_cast<uint64_t>(ref.offset) + ref.size > text.size()) {
+            throw BaseFile::FormatError("Malformed base file string reference");
+        }
+        add(i, CheckedFragment(text.substr(ref.offset, ref.size), records[i].split));
+    }
+}
+
+TCatalogue::ResponseFragments GetResponsesFromMapped(const BaseFile::View &base,
+                                                     const std::vector<const TCatalogue::Stop *> &stops,
+                                                     const std::vector<const TCatalogue::Bus *> &buses) {
+    using BaseFile::SectionId;
+    TCatalogue::ResponseFragments result;
+    if (!base.Has(SectionId::RESPONSE_TEXT)) {
+        return result;
+    }
+    AddResponsesFromMapped(base, SectionId::STOP_RESPONSES, stops.size(), [&](size_t i, auto fragment) {
+        result.AddStop(stops[i]->name, std::move(fragment));
+    });
+    AddResponsesFromMapped(base, SectionId::BUS_RESPONSES, buses.size(), [&](size_t i, auto fragment) {
+        result.AddBus(buses[i]->name, std::move(fragment));
+    });
+    return result;
+}
+
+graph::DirectedWeightedGraph<double> GetGraphFromMapped(const BaseFile::View &base,
+                                                        const std::vector<const TCatalogue::Stop *> &stops,
+                                                        const std::vector<const TCatalogue::Bus *> &buses) {
+    using BaseFile::SectionId;
+    const auto incidence_offsets = base.Records<uint32_t>(SectionId::INCIDENCE_OFFSETS);
+    const auto incidence_edges = base.Records<uint32_t>(SectionId::INCIDENCE_EDGES);
+    const size_t vertex_count = incidence_offsets.empty() ? 0 : incidence_offsets.size() - 1;
+    const auto edge_records = base.Records<BaseFile::EdgeRecord>(SectionId::EDGES);
+    std::vector<graph::Edge<double>> edges;
+    edges.reserve(edge_records.size());
+    for (const auto &record: edge_records) {
+        CheckIndex(record.from, vertex_count);
+        CheckIndex(record.to, vertex_count);
+        CheckIndex(record.owner, record.span == 0 ? stops.size() : buses.size());
+        const std::string_view name = record.span == 0 ? stops[record.owner]->name : buses[record.owner]->name;
+        edges.push_back({name, record.span, record.from, record.to, record.weight});
+    }
+    std::vector<std::vector<graph::EdgeId>> incidence_lists(vertex_count);
+    for (size_t vertex = 0; vertex < vertex_count; ++vertex) {
+        const uint32_t begin = incidence_offsets[vertex];
+        const uint32_t end = incidence_offsets[vertex + 1];
+        if (begin > end || end > incidence_edges.size()) {
+            throw BaseFile::FormatError("Malformed base file reference");
+        }
+        for (uint32_t i = begin; i < end; ++i) {
+            CheckIndex(incidence_edges[i], edges.size());
+            incidence_lists[vertex].push_back(incidence_edges[i]);
+        }
+    }
+    return {std::move(edges), std::move(incidence_lists)};
+}
+
+std::map<std::string, graph::VertexId> GetStopVerticesFromMapped(const BaseFile::View &base,
+                                                                 const std::vector<const TCatalogue::Stop *> &stops) {
+    using BaseFile::SectionId;
+    std::map<std::string, graph::VertexId> stop_ids;
+    const auto stop_vertices = base.Records<uint32_t>(SectionId::STOP_VERTICES);
+    if (stop_vertices.size() != stops.size()) {
+        throw BaseFile::FormatError("Malformed base file reference");
+    }
+    // Число вершин графа задаёт INCIDENCE_OFFSETS, как в GetGraphFromMapped
+    const size_t offset_count = base.Records<uint32_t>(SectionId::INCIDENCE_OFFSETS).size();
+    const size_t vertex_count = offset_count == 0 ? 0 : offset_count - 1;
+    for (size_t i = 0; i < stops.size(); ++i) {
+        CheckIndex(stop_vertices[i], vertex_count);
+        stop_ids.emplace_hint(stop_ids.end(), stops[i]->name, stop_vertices[i]);
+    }
+    return stop_ids;
+}
+
+DeserializedBase DeserializeMapped(std::string_view data, bool with_distances) {
+    using BaseFile::SectionId;
+    const BaseFile::View base(data);
+
     TCatalogue::TransportCatalogue catalogue;
-    Render::MapRenderer renderer(GetRenderSettingsFromDB(database));
-    TRouting::TRouter router(GetRouterSettingsFromDB(database.router()));
-    AddStopFromDB(catalogue, database);
-    AddBusFromDB(catalogue, database);
-    return {std::move(catalogue), std::move(renderer), std::move(router),
-            GetGraphFromDB(database.router()),
-            GetStopIdsFromDB(database.router())};
+    const auto stop_records = base.Records<BaseFile::StopRecord>(SectionId::STOPS);
+    std::vector<const TCatalogue::Stop *> stops;
+    stops.reserve(stop_records.size());
+    for (const auto &record: stop_records) {
+        stops.push_back(catalogue.AddStop(base.String(record.name), {record.latitude, record.longitude}));
+    }
+    if (with_distances) {
+        CheckHasDistances(base.Has(SectionId::ROAD_DISTANCES));
+        for (const auto &record: base.Records<BaseFile::DistanceRecord>(SectionId::ROAD_DISTANCES)) {
+            CheckIndex(record.from, stops.size());
+            CheckIndex(record.to, stops.size());
+            catalogue.SetDistanseToTwoStops(stops[record.from], stops[record.to], record.distance);
+        }
+    }
+
+    const auto bus_stops = base.Records<uint32_t>(SectionId::BUS_STOPS);
+    const auto bus_records = base.Records<BaseFile::BusRecord>(SectionId::BUSES);
+    std::vector<std::vector<const TCatalogue::Stop *>> routes(bus_records.size());
+    Parallel::ForEachRange(routes.size(), BUSES_PER_BLOCK, [&](size_t begin, size_t end) {
+        for (size_t bus = begin; bus < end; ++bus) {
+            const BaseFile::BusRecord &record = bus_records[bus];
+            if (static_cast<uint64_t>(record.first_stop) + record.stop_count > bus_stops.size()) {
+                throw BaseFile::FormatError("Malformed base file reference");
+            }
+            std::vector<const TCatalogue::Stop *> &route = routes[bus];
+            route.resize(record.stop_count);
+            for (size_t i = 0; i < route.size(); ++i) {
+                const uint32_t stop_id = bus_stops[record.first_stop + i];
+                CheckIndex(stop_id, stops.size());
+                route[i] = stops[stop_id];
+            }
+        }
+    });
+    std::vector<const TCatalogue::Bus *> buses;
+    buses.reserve(bus_records.size());
+    for (size_t bus = 0; bus < bus_records.size(); ++bus) {
+        const BaseFile::BusRecord &record = bus_records[bus];
+        buses.push_back(catalogue.AddBusFromDb(base.String(record.name), std::move(routes[bus]), record.is_loop != 0,
+                                               {record.stops_count, record.unique_stops,
+                                                record.road_length, record.curvature}));
+    }
+
+    TCatalogue::NameIndex name_index;
+    graph::DirectedWeightedGraph<double> graph;
+    std::map<std::string, graph::VertexId> stop_ids;
+    TCatalogue::ResponseFragments responses;
+    // Индекс названий, граф, вершины остановок и готовые ответы не зависят друг от друга
+    Parallel::ForEachRange(4, 1, [&](size_t begin, size_t end) {
+        for (size_t task = begin; task < end; ++task) {
+            if (task == 0) {
+                name_index = GetNameIndexFromMapped(base, stops, buses);
+            } else if (task == 1) {
+                graph = GetGraphFromMapped(base, stops, buses);
+            } else if (task == 2) {
+                stop_ids = GetStopVerticesFromMapped(base, stops);
+            } else {
+                responses = GetResponsesFromMapped(base, stops, buses);
+            }
+        }
+    });
+    catalogue.SetNameIndex(std::move(name_index));
+    catalogue.SetResponseFragments(std::move(responses));
+
+    Render::MapRenderer renderer(GetRenderSettingsFromDB(
+            ParseSection<serialization::RenderSettings>(base.Bytes(SectionId::RENDER_SETTINGS))));
+    if (base.Has(SectionId::MAP_JSON)) {
+        renderer.SetMapJson(std::string(base.Bytes(SectionId::MAP_JSON)));
+    }
+    TRouting::TRouter router(GetRouterSettingsFromDB(
+            ParseSection<serialization::RouterSettings>(base.Bytes(SectionId::ROUTER_SETTINGS))));
+    return {std::move(catalogue), std::move(renderer), std::move(router), std::move(graph), std::move(stop_ids)};
+}
+
+void WriteBase(const Json::Dict &serialization_settings,
+               const TCatalogue::TransportCatalogue &TCatalog,
+               const Render::MapRenderer &renderer, const TRouting::TRouter &router,
+               std::ostream &output) {
+    const auto format = serialization_settings.find("format");
+    if (format != serialization_settings.end() && format->second.AsString() == "protobuf"sv) {
+        Serialize(TCatalog, renderer, router, output);
+    } else {
+        SerializeMapped(TCatalog, renderer, router, output);
+    }
+}
+
+void SaveBase(const Json::Dict &serialization_settings,
+              const TCatalogue::TransportCatalogue &TCatalog,
+              const Render::MapRenderer &renderer, const TRouting::TRouter &router) {
+    const std::string path(serialization_settings.at("file").AsString());
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream fout(temporary, std::ios::binary);
+        if (!fout.is_open()) {
+            throw std::runtime_error("Cannot write base file " + temporary);
+        }
+        WriteBase(serialization_settings, TCatalog, renderer, router, fout);
+        if (!fout.flush()) {
+            throw std::runtime_error("Cannot write base file " + temporary);
+        }
+    }
+    std::filesystem::rename(temporary, path);
+}
+
+DeserializedBase LoadBase(const std::string &path, bool with_distances) {
+    const BaseFile::MappedFile file(path);
+    const std::string_view data = file.Data();
+    if (BaseFile::IsBaseFile(data)) {
+        return DeserializeMapped(data, with_distances);
+    }
+    google::protobuf::Arena arena;
+    return Deserialize(ParseChunks(data, arena), with_distances);
 }
\ No newline at end of file
@@ -2,7 +2,11 @@
 
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
 
 #include "transport_catalogue.h"
 #include "map_renderer.h"
@@ -10,21 +14,69 @@
 
 #include <transport_catalogue.pb.h>
 
+// Номера остановок и маршрутов в базе — их позиции в порядке названий
+struct BaseIds {
+    std::unordered_map<std::string_view, uint32_t> stops;
+    std::unordered_map<std::string_view, uint32_t> buses;
+};
+
+BaseIds NumberNames(const TCatalogue::TransportCatalogue &transportCatalogue);
+
+// Пишет protobuf версии 2: маршруты и рёбра ссылаются на остановки по номерам, рёбра хранятся
+// по столбцам, вес поездки — длиной в метрах. Deserialize читает и версию 1
 void Serialize(const TCatalogue::TransportCatalogue &TCatalog,
                const Render::MapRenderer &renderer,
                const TRouting::TRouter &router,
                std::ostream &output);
 
-serialization::Stop Serialize(const TCatalogue::TransportCatalogue &transportCatalogue,
-                          const TCatalogue::Stop *stop);
+// Части базы заполняются на месте, чтобы сообщения оставались на арене своего фрагмента
+void Serialize(const TCatalogue::TransportCatalogue &transportCatalogue, const TCatalogue::Stop *stop,
+               serialization::Stop *result);
 
-serialization::Bus Serialize(const TCatalogue::Bus *bus, const TCatalogue::TransportCatalogue &transportCatalogue);
+void Serialize(const TCatalogue::Bus *bus, const TCatalogue::TransportCatalogue &transportCatalogue,
+               const BaseIds &ids, serialization::Bus *result);
 
 serialization::RenderSettings GetRenderSettingSerialize(const Json::Node &render_settings);
 
 serialization::RouterSettings GetRouterSettingSerialize(const Json::Node &router_settings);
 
-serialization::Router Serialize(const TRouting::TRouter &router);
+void Serialize(const TRouting::TRouter &router, const BaseIds &ids, serialization::Router *result);
+
+void Serialize(const TCatalogue::NameIndex &index, const BaseIds &ids, serialization::NameIndex *result);
+
+// Граф и идентификаторы вершин передаются маршрутизатору через SetGraph уже на месте его хранения
+using DeserializedBase = std::tuple<TCatalogue::TransportCatalogue, Render::MapRenderer, TRouting::TRouter,
+        graph::DirectedWeightedGraph<double>, std::map<std::string, graph::VertexId>>;
+
+// Расстояния по дорогам нужны только для изменения базы (make_base --update), поэтому
+// загружаются в справочник лишь при with_distances. Если их нет в базе, это ошибка
+DeserializedBase Deserialize(std::istream &input, bool with_distances = false);
+
+DeserializedBase Deserialize(const serialization::TransportCatalogue &database, bool with_distances = false);
+
+// База в формате для отображения в память (base_file.h). Protobuf остаётся форматом
+// импорта и экспорта: LoadBase различает форматы по сигнатуре файла
+void SerializeMapped(const TCatalogue::TransportCatalogue &TCatalog,
+                     const Render::MapRenderer &renderer,
+                     const TRouting::TRouter &router,
+                     std::ostream &output);
+
+DeserializedBase DeserializeMapped(std::string_view data, bool with_distances = false);
+
+// Пишет базу в формате из serialization_settings: protobuf при "format": "protobuf",
+// иначе формат для отображения в память
+void WriteBase(const Json::Dict &serialization_settings,
+               const TCatalogue::TransportCatalogue &TCatalog,
+               const Render::MapRenderer &renderer,
+               const TRouting::TRouter &router,
+               std::ostream &output);
+
+// Пишет базу в файл из serialization_settings. Файл сначала записывается рядом под именем с
+// суффиксом .tmp и затем заменяет прежний переименованием: процессы, отобразившие прежнюю базу
+// в память, дочитывают её целиком, а не видят обрезанный файл
+void SaveBase(const Json::Dict &serialization_settings,
+              const TCatalogue::TransportCatalogue &TCatalog,
+              const Render::MapRenderer &renderer,
+              const TRouting::TRouter &router);
 
-std::tuple<TCatalogue::TransportCatalogue, Render::MapRenderer, TRouting::TRouter,
-        graph::DirectedWeightedGraph<double>, std::map<std::string, graph::VertexId>> Deserialize(std::istream &input);
\ No newline at end of file
+DeserializedBase LoadBase(const std::string &path, bool with_distances = false);
\ No newline at end of file
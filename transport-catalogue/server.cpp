@@ -0,0 +1,586 @@
+#include "server.h"
+#include "json.h"
+#include "json_reader.h"
+
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace Server {
+
+    namespace {
+
+        constexpr auto RELOAD_CHECK_INTERVAL = std::chrono::seconds(1);
+        // Пачка длиннее не накапливается в памяти: остаток строки пропускается, а в ответ идёт ошибка
+        constexpr size_t MAX_BATCH_BYTES = 64 << 20;
+        // Пауза после временной нехватки дескрипторов или памяти при приёме соединения
+        constexpr auto ACCEPT_BACKOFF = std::chrono::milliseconds(100);
+        // Сколько после запроса на остановку ждать клиента, который не дочитывает ответ
+        constexpr auto STOP_GRACE = std::chrono::seconds(2);
+
+        std::atomic<bool> stop_requested{false};
+        std::atomic<bool> reload_requested{false};
+
+        void OnSignal(int signal) {
+            if (signal == SIGHUP) {
+                reload_requested = true;
+            } else {
+                stop_requested = true;
+            }
+        }
+
+        // SIGINT, SIGTERM и SIGHUP блокируются во всех потоках и доставляются только во время
+        // ожидания в основном потоке (ppoll с маской wait_mask), поэтому сигнал не теряется между
+        // проверкой флага и началом ожидания. SIGPIPE от закрывшегося клиента игнорируется
+        class ControlSignals {
+        public:
+            ControlSignals() {
+                struct sigaction action{};
+                action.sa_handler = OnSignal;
+                sigemptyset(&action.sa_mask);
+                sigset_t blocked;
+                sigemptyset(&blocked);
+                for (const int signal: {SIGINT, SIGTERM, SIGHUP}) {
+                    sigaction(signal, &action, nullptr);
+                    sigaddset(&blocked, signal);
+                }
+                std::signal(SIGPIPE, SIG_IGN);
+
+                pthread_sigmask(SIG_BLOCK, &blocked, &wait_mask_);
+                for (const int signal: {SIGINT, SIGTERM, SIGHUP}) {
+                    sigdelset(&wait_mask_, signal);
+                }
+            }
+
+            [[nodiscard]] const sigset_t *WaitMask() const {
+                return &wait_mask_;
+            }
+
+        private:
+            sigset_t wait_mask_{};
+        };
+
+        [[noreturn]] void ThrowSystemError(const char *what) {
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+
+        timespec ToTimespec(std::chrono::nanoseconds duration) {
+            const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(duration);
+            return {static_cast<time_t>(seconds.count()), static_cast<long>((duration - seconds).count())};
+        }
+
+        // Ждёт событий в fds. Возвращает false, если ожидание прервано запросом на остановку
+        bool Wait(pollfd *fds, nfds_t count, const sigset_t *wait_mask) {
+            while (true) {
+                if (wait_mask && stop_requested) {
+                    return false;
+                }
+                if (ppoll(fds, count, nullptr, wait_mask) >= 0) {
+                    return true;
+                }
+                if (errno != EINTR) {
+                    ThrowSystemError("poll");
+                }
+            }
+        }
+
+        // Пауза, которую прерывает сигнал
+        void Pause(std::chrono::nanoseconds duration, const sigset_t *wait_mask) {
+            const timespec timeout = ToTimespec(duration);
+            ppoll(nullptr, 0, &timeout, wait_mask);
+        }
+
+        // Откуда читаются пачки и куда пишутся ответы. Запрос на остановку — это stop_requested,
+        // если ожидание идёт с маской wait_mask, или готовность stop_fd к чтению
+        struct Channel {
+            int input;
+            int output;
+            const sigset_t *wait_mask = nullptr;
+            int stop_fd = -1;
+        };
+
+        // Ждёт events на fd. Возвращает false, если раньше пришёл запрос на остановку
+        bool WaitFor(int fd, short events, const Channel &channel) {
+            pollfd fds[] = {{fd, events, 0}, {channel.stop_fd, POLLIN, 0}};
+            return Wait(fds, std::size(fds), channel.wait_mask) && !(fds[1].revents & POLLIN);
+        }
+
+        // Ждёт events на fd не дольше, чем до deadline. Остановка здесь уже не прерывает ожидание
+        bool WaitUntil(int fd, short events, std::chrono::steady_clock::time_point deadline) {
+            pollfd request{fd, events, 0};
+            while (true) {
+                const auto left = deadline - std::chrono::steady_clock::now();
+                if (left <= std::chrono::steady_clock::duration::zero()) {
+                    return false;
+                }
+                const timespec timeout = ToTimespec(left);
+                const int ready = ppoll(&request, 1, &timeout, nullptr);
+                if (ready >= 0) {
+                    return ready > 0;
+                }
+                if (errno != EINTR) {
+                    ThrowSystemError("poll");
+                }
+            }
+        }
+
+        bool StopRequested(const Channel &channel) {
+            pollfd request{channel.stop_fd, POLLIN, 0};
+            // Нулевое ожидание с wait_mask заодно доставляет отложенный сигнал
+            const timespec now{};
+            ppoll(&request, 1, &now, channel.wait_mask);
+            return (request.revents & POLLIN) || (channel.wait_mask && stop_requested);
+        }
+
+        // Пишет data целиком. После запроса на остановку клиенту остаётся STOP_GRACE, чтобы
+        // дочитать ответ: клиент, который перестал читать, не должен задерживать завершение
+        void WriteAll(std::string_view data, const Channel &channel) {
+            // Блокирующая запись в канал больше PIPE_BUF может зависнуть и после poll
+            const size_t max_write = fcntl(channel.output, F_GETFL) & O_NONBLOCK ? data.size() : PIPE_BUF;
+            std::optional<std::chrono::steady_clock::time_point> deadline;
+            while (!data.empty()) {
+                if (!deadline && !WaitFor(channel.output, POLLOUT, channel)) {
+                    deadline = std::chrono::steady_clock::now() + STOP_GRACE;
+                }
+                if (deadline && !WaitUntil(channel.output, POLLOUT, *deadline)) {
+                    throw std::system_error(ETIMEDOUT, std::generic_category(), "write");
+                }
+                const ssize_t written = write(channel.output, data.data(), std::min(data.size(), max_write));
+                if (written < 0) {
+                    if (errno == EINTR || errno == EAGAIN) {
+                        continue;
+                    }
+                    ThrowSystemError("write");
+                }
+                data.remove_prefix(static_cast<size_t>(written));
+            }
+        }
+
+        bool IsBlank(std::string_view line) {
+            return line.find_first_not_of(" \t\r") == std::string_view::npos;
+        }
+
+        std::string ErrorAnswer(std::string_view message) {
+            std::ostringstream output;
+            Json::Writer writer(output);
+            writer.StartDict().Key("error_message").Value(message).EndDict();
+            writer.Flush();
+            return std::move(output).str();
+        }
+
+        // Читает пачки, разделённые переводом строки, и отвечает на них. Завершается в конце ввода
+        // или по запросу на остановку; недочитанная к этому моменту пачка отбрасывается
+        void ServeConnection(const SnapshotStore &store, const Channel &channel) {
+            std::string buffer;
+            size_t line_begin = 0;
+            // Текущая пачка превысила MAX_BATCH_BYTES и пропускается до перевода строки
+            bool oversized = false;
+            char chunk[1 << 16];
+            const auto answer = [&](std::string_view line) {
+                if (oversized) {
+                    oversized = false;
+                    WriteAll(ErrorAnswer("Batch is too large") + '\n', channel);
+                } else if (!IsBlank(line)) {
+                    WriteAll(AnswerBatch(line, *store.Current()) + '\n', channel);
+                }
+            };
+            while (WaitFor(channel.input, POLLIN, channel)) {
+                const ssize_t count = read(channel.input, chunk, sizeof(chunk));
+                if (count < 0) {
+                    if (errno == EINTR || errno == EAGAIN) {
+                        continue;
+                    }
+                    ThrowSystemError("read");
+                }
+                if (count == 0) {
+                    // Последняя пачка может быть не завершена переводом строки
+                    answer(buffer);
+                    return;
+                }
+                buffer.append(chunk, static_cast<size_t>(count));
+                for (size_t line_end; (line_end = buffer.find('\n', line_begin)) != std::string::npos;) {
+                    if (StopRequested(channel)) {
+                        return;
+                    }
+                    answer(std::string_view(buffer.data() + line_begin, line_end - line_begin));
+                    line_begin = line_end + 1;
+                }
+                buffer.erase(0, line_begin);
+                line_begin = 0;
+                if (buffer.size() > MAX_BATCH_BYTES) {
+                    oversized = true;
+                    buffer.clear();
+                }
+            }
+        }
+
+        // Клиенты, каждого из которых обслуживает свой поток. Поток сам закрывает сокет, как только
+        // ответил на последнюю пачку, и будит основной поток через eventfd, чтобы тот сразу его
+        // присоединил. Об остановке потоки узнают по второму eventfd
+        class Connections {
+        public:
+            Connections()
+                    : wakeup_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+                      stop_(eventfd(0, EFD_CLOEXEC)) {
+                if (wakeup_ < 0 || stop_ < 0) {
+                    const int error = errno;
+                    close(wakeup_);
+                    close(stop_);
+                    throw std::system_error(error, std::generic_category(), "eventfd");
+                }
+            }
+
+            Connections(const Connections &) = delete;
+
+            Connections &operator=(const Connections &) = delete;
+
+            ~Connections() {
+                StopAll();
+                close(wakeup_);
+                close(stop_);
+            }
+
+            // Становится доступен для чтения, когда есть завершившиеся потоки
+            [[nodiscard]] int WakeupFd() const {
+                return wakeup_;
+            }
+
+            // Забирает fd; если поток не удалось запустить, fd закрывается
+            void Start(const SnapshotStore &store, int fd) {
+                std::lock_guard guard(mutex_);
+                Connection &connection = connections_.emplace_back(fd);
+                // Поток наследует маску с заблокированными управляющими сигналами
+                try {
+                    connection.thread = std::thread([this, &store, &connection] { Serve(store, connection); });
+                } catch (...) {
+                    close(fd);
+                    connections_.pop_back();
+                    throw;
+                }
+            }
+
+
+            void JoinFinished() {
+                uint64_t count;
+                static_cast<void>(read(wakeup_, &count, sizeof(count)));
+                std::list<Connection> finished;
+                {
+                    std::lock_guard guard(mutex_);
+                    for (auto it = connections_.begin(); it != connections_.end();) {
+                        const auto next = std::next(it);
+                        if (it->done) {
+                            finished.splice(finished.end(), connections_, it);
+                        }
+                        it = next;
+                    }
+                }
+                for (auto &connection: finished) {
+                    connection.thread.join();
+                }
+            }
+
+            // Новые пачки больше не читаются, недочитанные отбрасываются. Ответ, который уже
+            // пишется, дописывается, пока клиент его читает, но не дольше STOP_GRACE
+            void StopAll() {
+                const uint64_t one = 1;
+                static_cast<void>(write(stop_, &one, sizeof(one)));
+                for (auto &connection: connections_) {
+                    connection.thread.join();
+                }
+                connections_.clear();
+            }
+
+        private:
+            struct Connection {
+                explicit Connection(int fd) : fd(fd) {}
+
+                int fd;
+                std::thread thread;
+                // Сокет закрыт, поток можно присоединять
+                bool done = false;
+            };
+
+            void Serve(const SnapshotStore &store, Connection &connection) {
+                try {
+                    ServeConnection(store, {connection.fd, connection.fd, nullptr, stop_});
+                } catch (const std::system_error &) {
+                    // Клиент отключился или не дочитал ответ до остановки
+                }
+                {
+                    std::lock_guard guard(mutex_);
+                    close(connection.fd);
+                    connection.done = true;
+                }
+                const uint64_t one = 1;
+                static_cast<void>(write(wakeup_, &one, sizeof(one)));
+            }
+
+            std::mutex mutex_;
+            std::list<Connection> connections_;
+            int wakeup_;
+            int stop_;
+        };
+
+        // Владеет файловым дескриптором
+        class FileDescriptor {
+        public:
+            explicit FileDescriptor(int fd)
+                    : fd_(fd) {
+            }
+
+            FileDescriptor(const FileDescriptor &) = delete;
+
+            FileDescriptor &operator=(const FileDescriptor &) = delete;
+
+            ~FileDescriptor() {
+                if (fd_ >= 0) {
+                    close(fd_);
+                }
+            }
+
+            [[nodiscard]] int Get() const {
+                return fd_;
+            }
+
+        private:
+            int fd_;
+        };
+
+        // Удаляет созданный bind файл сокета, в том числе при выходе по исключению
+        class SocketFile {
+        public:
+            explicit SocketFile(std::string path)
+                    : path_(std::move(path)) {
+            }
+
+            SocketFile(const SocketFile &) = delete;
+
+            SocketFile &operator=(const SocketFile &) = delete;
+
+            ~SocketFile() {
+                unlink(path_.c_str());
+            }
+
+        private:
+            std::string path_;
+        };
+
+        // Ошибки accept, которые проходят сами, когда другие соединения освобождают ресурсы
+        bool IsTemporaryAcceptError(int error) {
+            return error == EMFILE || error == ENFILE || error == ENOBUFS || error == ENOMEM;
+        }
+
+        std::shared_ptr<const Snapshot> LoadSnapshot(const std::string &path) {
+            auto snapshot = std::make_shared<const Snapshot>(path);
+            snapshot->Warm();
+            return snapshot;
+        }
+
+        std::filesystem::file_time_type ModificationTime(const std::string &path) {
+            std::error_code error;
+            const auto time = std::filesystem::last_write_time(path, error);
+            return error ? std::filesystem::file_time_type{} : time;
+        }
+
+        // Фоновый поток, перечитывающий базу. Файл перечитывается, когда время его изменения
+        // отличается от загруженного и не менялось с прошлой проверки: так не читается файл,
+        // который ещё дописывается. Вытесненные снимки освобождаются здесь же, когда ими
+        // перестают пользоваться
+        class Reloader {
+        public:
+            explicit Reloader(SnapshotStore &store)
+                    : store_(store),
+                      thread_([this] { Run(); }) {
+            }
+
+            ~Reloader() {
+                {
+                    std::lock_guard guard(mutex_);
+                    stopping_ = true;
+                }
+                wakeup_.notify_one();
+                thread_.join();
+            }
+
+        private:
+            void Run() {
+                auto loaded = ModificationTime(store_.GetPath());
+                auto seen = loaded;
+                std::vector<std::shared_ptr<const Snapshot>> retired;
+                std::unique_lock lock(mutex_);
+                while (!wakeup_.wait_for(lock, RELOAD_CHECK_INTERVAL, [this] { return stopping_; })) {
+                    std::erase_if(retired, [](const auto &snapshot) {
+                        return snapshot.use_count() == 1;
+                    });
+                    const auto time = ModificationTime(store_.GetPath());
+                    const bool changed = time != loaded && time == seen;
+                    seen = time;
+                    if (reload_requested.exchange(false) || changed) {
+                        lock.unlock();
+                        if (auto previous = store_.Reload()) {
+                            retired.push_back(std::move(previous));
+                        }
+                        // Испорченный файл повторно читается только после следующего изменения
+                        loaded = time;
+                        lock.lock();
+                    }
+                }
+            }
+
+            SnapshotStore &store_;
+            std::mutex mutex_;
+            std::condition_variable wakeup_;
+            bool stopping_ = false;
+            std::thread thread_;
+        };
+
+    }  // namespace
+
+    Snapshot::Snapshot(const std::string &path)
+            : Snapshot(LoadBase(path)) {
+    }
+
+    Snapshot::Snapshot(DeserializedBase base)
+            : catalogue_(std::move(std::get<0>(base))),
+              renderer_(std::move(std::get<1>(base))),
+              router_(std::move(std::get<2>(base))) {
+        router_.SetGraph(std::move(std::get<3>(base)), std::move(std::get<4>(base)));
+    }
+
+    RequestHandler Snapshot::MakeHandler() const {
+        return {catalogue_, renderer_, router_};
+    }
+
+    void Snapshot::Warm() const {
+        router_.BuildRouter();
+        static_cast<void>(MakeHandler().RenderMapJson());
+    }
+
+    SnapshotStore::SnapshotStore(std::string path)
+            : path_(std::move(path)),
+              current_(LoadSnapshot(path_)) {
+    }
+
+    std::shared_ptr<const Snapshot> SnapshotStore::Current() const {
+        return current_.load(std::memory_order_acquire);
+    }
+
+    const std::string &SnapshotStore::GetPath() const {
+        return path_;
+    }
+
+    std::shared_ptr<const Snapshot> SnapshotStore::Reload() {
+        try {
+            return current_.exchange(LoadSnapshot(path_), std::memory_order_acq_rel);
+        } catch (const std::exception &e) {
+            std::cerr << "Base reload failed: " << e.what() << '\n';
+            return nullptr;
+        }
+    }
+
+    std::string AnswerBatch(std::string_view batch, const Snapshot &snapshot) {
+        try {
+            std::ostringstream output;
+            RequestHandler handler = snapshot.MakeHandler();
+            JsonReader::ReadBatch(batch, handler, output);
+            return std::move(output).str();
+        } catch (const std::exception &e) {
+            return ErrorAnswer(e.what());
+        }
+    }
+
+    void ServeStdin(SnapshotStore &store) {
+        const ControlSignals signals;
+        const Reloader reloader(store);
+        ServeConnection(store, {STDIN_FILENO, STDOUT_FILENO, signals.WaitMask()});
+    }
+
+    void ServeSocket(SnapshotStore &store, const std::string &path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::invalid_argument("Socket path is too long: " + path);
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        // Чтобы опечатка в пути не удалила обычный файл, заменяется только оставшийся сокет
+        struct stat existing{};
+        if (lstat(path.c_str(), &existing) == 0) {
+            if (!S_ISSOCK(existing.st_mode)) {
+                throw std::invalid_argument("Not a socket: " + path);
+            }
+            unlink(path.c_str());
+        }
+
+        const ControlSignals signals;
+        const Reloader reloader(store);
+        // Объявлены в обратном порядке остановки: сначала закрывается сокет, затем дообслуживаются
+        // клиенты
+        Connections connections;
+        const FileDescriptor listener(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (listener.Get() < 0) {
+            ThrowSystemError("socket");
+        }
+        if (bind(listener.Get(), reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0) {
+            const int error = errno;
+            throw std::system_error(error, std::generic_category(), "bind " + path);
+        }
+        const SocketFile socket_file(path);
+        if (listen(listener.Get(), SOMAXCONN) < 0) {
+            const int error = errno;
+            throw std::system_error(error, std::generic_category(), "listen " + path);
+        }
+
+        pollfd events[] = {{listener.Get(), POLLIN, 0}, {connections.WakeupFd(), POLLIN, 0}};
+        while (Wait(events, std::size(events), signals.WaitMask())) {
+            if (events[1].revents & POLLIN) {
+                connections.JoinFinished();
+            }
+            if (!(events[0].revents & POLLIN)) {
+                continue;
+            }
+            const int fd = accept4(listener.Get(), nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            if (fd < 0) {
+                if (IsTemporaryAcceptError(errno)) {
+                    std::cerr << "accept: " << std::generic_category().message(errno) << '\n';
+                    Pause(ACCEPT_BACKOFF, signals.WaitMask());
+                } else if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED) {
+                    ThrowSystemError("accept");
+                }
+                continue;
+            }
+            try {
+                connections.Start(store, fd);
+            } catch (const std::system_error &e) {
+                // Не хватило ресурсов на поток: этот клиент отключается, остальные обслуживаются
+                std::cerr << "Connection thread: " << e.what() << '\n';
+                Pause(ACCEPT_BACKOFF, signals.WaitMask());
+            }
+        }
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "map_renderer.h"
+#include "request_handler.h"
+#include "serialization.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Долгоживущий режим: база загружается один раз, после чего процесс отвечает на пачки запросов.
+// Пачка — одна строка JSON (массив stat_requests или документ с этим разделом), ответ на неё —
+// тоже одна строка; на пачку длиннее 64 МБ отвечает ошибка. Пачки читаются со стандартного ввода
+// или из соединений через Unix-сокет. База перечитывается в фоне по SIGHUP или после изменения
+// её файла; новую базу лучше публиковать переименованием готового файла поверх старого
+namespace Server {
+
+    // Загруженная база. Маршрутизатор ссылается на граф, хранящийся в нём же, поэтому объект
+    // не копируется и не перемещается
+    class Snapshot {
+    public:
+        // Загружает базу любого поддерживаемого формата (см. LoadBase)
+        explicit Snapshot(const std::string &path);
+
+        Snapshot(const Snapshot &) = delete;
+
+        Snapshot &operator=(const Snapshot &) = delete;
+
+        [[nodiscard]] RequestHandler MakeHandler() const;
+
+        // Строит заранее то, что иначе строилось бы при первом запросе: маршрутизатор и карту.
+        // serve вызывает его до публикации снимка, чтобы первые запросы к новой базе не ждали
+        void Warm() const;
+
+    private:
+        explicit Snapshot(DeserializedBase base);
+
+        TCatalogue::TransportCatalogue catalogue_;
+        Render::MapRenderer renderer_;
+        TRouting::TRouter router_;
+    };
+
+    // Текущий снимок базы из файла path. Reload загружает новый снимок рядом со старым и подменяет
+    // указатель атомарно: пачки, начатые до подмены, дорабатывают со старым снимком, новые берут
+    // новый. Читателю достаточно скопировать shared_ptr, общих блокировок нет
+    class SnapshotStore {
+    public:
+        explicit SnapshotStore(std::string path);
+
+        [[nodiscard]] std::shared_ptr<const Snapshot> Current() const;
+
+        [[nodiscard]] const std::string &GetPath() const;
+
+        // Возвращает предыдущий снимок, чтобы вызывающий освободил его сам, а не последний
+        // читатель посреди обработки запроса. При ошибке загрузки текущий снимок остаётся,
+        // а результат пуст
+        std::shared_ptr<const Snapshot> Reload();
+
+    private:
+        std::string path_;
+        std::atomic<std::shared_ptr<const Snapshot>> current_;
+    };
+
+    // Ответ на пачку без завершающего перевода строки. Ошибка разбора или обработки пачки
+    // возвращается как { "error_message": ... } и не влияет на следующие пачки
+    std::string AnswerBatch(std::string_view batch, const Snapshot &snapshot);
+
+    // Отвечает на пачки со стандартного ввода, пока он не закончится или не придёт SIGINT/SIGTERM
+    void ServeStdin(SnapshotStore &store);
+
+    // Принимает клиентов на Unix-сокете path, каждого обслуживает отдельный поток. Оставшийся от
+    // прошлого запуска сокет заменяется, а другой файл по этому пути — ошибка. По SIGINT/SIGTERM
+    // перестаёт принимать соединения и читать пачки, удаляет сокет и дописывает уже начатые ответы
+    // клиентам, которые их читают, но не дольше пары секунд; недочитанные пачки отбрасываются
+    void ServeSocket(SnapshotStore &store, const std::string &path);
+
+}
@@ -1,9 +1,17 @@
 #include "svg.h"
 
+#include <charconv>
+
 namespace Svg {
 
     using namespace std::literals;
 
+    void RenderDouble(std::ostream &out, double value) {
+        char digits[32];
+        const auto [end, ec] = std::to_chars(std::begin(digits), std::end(digits), value,
+                                             std::chars_format::general, 6);
+        out.write(digits, end - digits);
+    }
 
     Text &Text::SetPosition(Point pos) {
         position_ = pos;
@@ -77,15 +85,6 @@ namespace Svg {
         return out;
     }
 
-    void Object::Render(const RenderContext &context) const {
-        context.RenderIndent();
-
-        // Делегируем вывод тега своим подклассам
-        RenderObject(context);
-
-        context.out << std::endl;
-    }
-
     Circle &Circle::SetCenter(Point center) {
         center_ = center;
         return *this;
@@ -98,8 +97,13 @@ namespace Svg {
 
     void Circle::RenderObject(const RenderContext &context) const {
         auto &out = context.out;
-        out << "<circle cx=\""sv << center_.x << "\" cy=\""sv << center_.y << "\" "sv;
-        out << "r=\""sv << radius_ << "\""sv;
+        out << "<circle cx=\""sv;
+        RenderDouble(out, center_.x);
+        out << "\" cy=\""sv;
+        RenderDouble(out, center_.y);
+        out << "\" r=\""sv;
+        RenderDouble(out, radius_);
+        out.put('"');
         RenderAttrs(context.out);
         out << "/>"sv;
     }
@@ -110,19 +114,24 @@ namespace Svg {
         return *this;
     }
 
+    void Polyline::ReservePoints(size_t count) {
+        points_.reserve(count);
+    }
+
     void Polyline::RenderObject(const RenderContext &context) const {
         auto &out = context.out;
         out << "<polyline points=\""sv;
         bool is_first = true;
-        for (auto &point: points_) {
-            if (is_first) {
-                out << point.x << "," << point.y;
-                is_first = false;
-            } else {
-                out << " "sv << point.x << "," << point.y;
+        for (const auto &point: points_) {
+            if (!is_first) {
+                out.put(' ');
             }
+            is_first = false;
+            RenderDouble(out, point.x);
+            out.put(',');
+            RenderDouble(out, point.y);
         }
-        out << "\"";
+        out.put('"');
         RenderAttrs(context.out);
         out << "/>"sv;
     }
@@ -140,16 +149,16 @@ namespace Svg {
         out << ">"sv << text_ << "</text>"sv;
     }
 
-    void Document::AddPtr(std::unique_ptr<Object> &&obj) {
-        objects_.emplace_back(std::move(obj));
+    void Document::Reserve(size_t count) {
+        objects_.reserve(count);
     }
 
     void Document::Render(std::ostream &out) const {
         RenderContext ctx(out, 2, 2);
-        out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << std::endl;
-        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << std::endl;
+        out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"sv;
+        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"sv;
         for (const auto &obj: objects_) {
-            obj->Render(ctx);
+            std::visit([&ctx](const auto &shape) { shape.Render(ctx); }, obj);
         }
         out << "</svg>"sv;
     }
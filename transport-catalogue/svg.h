@@ -2,7 +2,6 @@
 
 #include <cstdint>
 #include <iostream>
-#include <memory>
 #include <string>
 #include <vector>
 #include <optional>
@@ -93,6 +92,9 @@ namespace Svg {
         double y = 0;
     };
 
+    // Печатает число так же, как std::ostream по умолчанию (%g, 6 значащих цифр), но через std::to_chars
+    void RenderDouble(std::ostream &out, double value);
+
     struct RenderContext {
         RenderContext(std::ostream &out)
                 : out(out) {
@@ -117,36 +119,19 @@ namespace Svg {
         int indent = 0;
     };
 
+    // Общий вывод строки с тегом. Фигуры хранятся в документе по значению, поэтому Owner::RenderObject
+    // вызывается статически, без виртуальных функций
+    template<typename Owner>
     class Object {
     public:
-        void Render(const RenderContext &context) const;
-
-        virtual ~Object() = default;
-
-    private:
-        virtual void RenderObject(const RenderContext &context) const = 0;
-    };
-
-
-    class ObjectContainer {
-    public:
-        template<typename T>
-        void Add(T obj) {
-            AddPtr(std::make_unique<T>(std::move(obj)));
+        void Render(const RenderContext &context) const {
+            context.RenderIndent();
+            static_cast<const Owner &>(*this).RenderObject(context);
+            context.out.put('\n');
         }
 
-        virtual void AddPtr(std::unique_ptr<Object> &&obj) = 0;
-
     protected:
-        ~ObjectContainer() = default;
-    };
-
-
-    class Drawable {
-    public:
-        virtual ~Drawable() = default;
-
-        virtual void Draw(ObjectContainer &container) const = 0;
+        ~Object() = default;
     };
 
     template<typename Owner>
@@ -218,31 +203,37 @@ namespace Svg {
     };
 
 
-    class Circle : public Object, public PathProps<Circle> {
+    class Circle : public Object<Circle>, public PathProps<Circle> {
     public:
         Circle &SetCenter(Point center);
 
         Circle &SetRadius(double radius);
 
     private:
-        void RenderObject(const RenderContext &context) const override;
+        friend class Object<Circle>;
+
+        void RenderObject(const RenderContext &context) const;
 
         Point center_;
         double radius_ = 1.0;
     };
 
-    class Polyline : public Object, public PathProps<Polyline> {
+    class Polyline : public Object<Polyline>, public PathProps<Polyline> {
     public:
 
         Polyline &AddPoint(Point point);
 
+        void ReservePoints(size_t count);
+
     private:
-        void RenderObject(const RenderContext &context) const override;
+        friend class Object<Polyline>;
+
+        void RenderObject(const RenderContext &context) const;
 
         std::vector<Point> points_;
     };
 
-    class Text : public Object, public PathProps<Text> {
+    class Text : public Object<Text>, public PathProps<Text> {
     public:
         Text &SetPosition(Point pos);
 
@@ -257,7 +248,9 @@ namespace Svg {
         Text &SetData(std::string data);
 
     private:
-        void RenderObject(const RenderContext &context) const override;
+        friend class Object<Text>;
+
+        void RenderObject(const RenderContext &context) const;
 
         Point position_;
         Point offset_;
@@ -270,14 +263,28 @@ namespace Svg {
         std::string text_;
     };
 
-    class Document : public ObjectContainer {
+    using Shape = std::variant<Circle, Polyline, Text>;
+
+    // Фигуры лежат подряд в одном векторе в порядке добавления
+    class Document {
     public:
-        void AddPtr(std::unique_ptr<Object> &&obj) override;
+        template<typename T>
+        void Add(T obj) {
+            objects_.emplace_back(std::in_place_type<T>, std::move(obj));
+        }
+
+        // Создаёт фигуру прямо в документе. Ссылка действительна до следующего добавления
+        template<typename T>
+        T &Emplace() {
+            return std::get<T>(objects_.emplace_back(std::in_place_type<T>));
+        }
+
+        void Reserve(size_t count);
 
         void Render(std::ostream &out) const;
 
     private:
-        std::vector<std::unique_ptr<Object>> objects_;
+        std::vector<Shape> objects_;
     };
 
 }
\ No newline at end of file
@@ -2,12 +2,21 @@
 #include <stdexcept>
 #include "geo.h"
 #include <set>
+#include <unordered_set>
 
 namespace TCatalogue {
 
-    void TransportCatalogue::AddStop(const std::string_view &stop_name, const Geo::Coordinates &coordinates) {
-        stops_.push_back({std::string(stop_name), coordinates});
+    const Stop *TransportCatalogue::AddStop(const std::string_view &stop_name, const Geo::Coordinates &coordinates) {
+        if (const auto it = stopname_to_stop_.find(stop_name); it != stopname_to_stop_.end()) {
+            // Остановка принадлежит stops_, поэтому снимать const с указателя можно
+            Stop *stop = const_cast<Stop *>(it->second);
+            stop->coordinates = coordinates;
+            stop->cached_coordinates = Geo::CachedCoordinates(coordinates);
+            return stop;
+        }
+        stops_.push_back({std::string(stop_name), coordinates, Geo::CachedCoordinates(coordinates)});
         stopname_to_stop_[stops_.back().name] = &stops_.back();
+        return &stops_.back();
     }
 
     const Stop *TransportCatalogue::FindStop(const std::string_view &stop_name) const {
@@ -17,36 +26,44 @@ namespace TCatalogue {
 
     }
 
-    void
-    TransportCatalogue::AddBus(const std::string_view &bus_name, const std::vector<std::string> &stops, bool is_loop) {
-        buses_.push_back({std::string(bus_name), GetStopsPtrFromString(stops), is_loop});
-        busname_to_bus_[buses_.back().name] = &buses_.back();
-
-        for (const auto &stop: stops) {
-            for (auto &inner_stop: stops_) {
-                if (inner_stop.name == stop) {
-                    stop_to_busnames_[stopname_to_stop_[stop]].insert(busname_to_bus_.at(bus_name)); //?
-                }
+    const Bus *
+    TransportCatalogue::PushBus(const std::string_view &bus_name, std::vector<const Stop *> stops, bool is_loop) {
+        const Bus *bus;
+        if (const auto it = busname_to_bus_.find(bus_name); it != busname_to_bus_.end()) {
+            Bus *existing = const_cast<Bus *>(it->second);
+            for (const Stop *stop: existing->stops) {
+                stop_to_busnames_[stop].erase(existing);
             }
+            existing->stops = std::move(stops);
+            existing->is_loop = is_loop;
+            bus = existing;
+        } else {
+            buses_.push_back({std::string(bus_name), std::move(stops), is_loop});
+            bus = &buses_.back();
+            busname_to_bus_[bus->name] = bus;
         }
 
-        bus_to_route_info_[busname_to_bus_.at(bus_name)] = CalculateRouteInfo(bus_name);
+        for (const Stop *stop: bus->stops) {
+            stop_to_busnames_[stop].insert(bus);
+        }
+
+        return bus;
     }
 
-    void TransportCatalogue::AddBusFromDb(const std::string_view &bus_name, const std::vector<std::string> &stops,
-                                          bool is_loop, BusRouteInfo busRouteInfo) {
-        buses_.push_back({std::string(bus_name), GetStopsPtrFromString(stops), is_loop});
-        busname_to_bus_[buses_.back().name] = &buses_.back();
+    void TransportCatalogue::AddBus(const std::string_view &bus_name, std::vector<const Stop *> stops, bool is_loop) {
+        const Bus *bus = PushBus(bus_name, std::move(stops), is_loop);
+        bus_to_route_info_[bus] = CalculateRouteInfo(bus->name);
+    }
 
-        for (const auto &stop: stops) {
-            for (auto &inner_stop: stops_) {
-                if (inner_stop.name == stop) {
-                    stop_to_busnames_[stopname_to_stop_[stop]].insert(busname_to_bus_.at(bus_name)); //?
-                }
-            }
-        }
+    void TransportCatalogue::RecalculateRouteInfo(const Bus *bus) {
+        bus_to_route_info_[bus] = CalculateRouteInfo(bus->name);
+    }
 
-        bus_to_route_info_[busname_to_bus_.at(bus_name)] = busRouteInfo;
+    const Bus *TransportCatalogue::AddBusFromDb(const std::string_view &bus_name, std::vector<const Stop *> stops,
+                                                bool is_loop, BusRouteInfo busRouteInfo) {
+        const Bus *bus = PushBus(bus_name, std::move(stops), is_loop);
+        bus_to_route_info_[bus] = busRouteInfo;
+        return bus;
     }
 
     const Bus *TransportCatalogue::GetBusInfo(const std::string_view &bus) const {
@@ -55,19 +72,6 @@ namespace TCatalogue {
         } else return nullptr;
     }
 
-    std::vector<const Stop *> TransportCatalogue::GetStopsPtrFromString(const std::vector<std::string> &stops) {
-
-        std::vector<const Stop *> to_return;
-
-        to_return.reserve(stops.size());
-        for (const auto &stop: stops) {
-            to_return.push_back(stopname_to_stop_.at(stop));
-        }
-
-        return to_return;
-
-    }
-
     BusRouteInfo TransportCatalogue::GetRouteInfo(const std::string_view &route_name) const {
         return bus_to_route_info_.at(busname_to_bus_.at(route_name));
     }
@@ -84,19 +88,26 @@ namespace TCatalogue {
 
         int stopsCount = static_cast<int>(bus->stops.size());
 
+        std::vector<Geo::CachedCoordinates> points;
+        points.reserve(bus->stops.size());
+        for (const Stop *stop: bus->stops) {
+            points.push_back(stop->cached_coordinates);
+        }
+        const std::vector<double> geoDistances = Geo::ComputeDistances(points);
+
         if (bus->is_loop) {
             for (int i = 0; i + 1 != static_cast<int>(bus->stops.size()); ++i) {
                 const Stop *start = bus->stops[i];
                 const Stop *end = bus->stops[i + 1];
                 roadLenght += GetDistanceFromTwoStops(start, end);
-                geoLenght += ComputeDistance(start->coordinates, end->coordinates);
+                geoLenght += geoDistances[i];
             }
         } else {
             for (int i = 0; i + 1 != static_cast<int>(bus->stops.size()); ++i) {
                 const Stop *start = bus->stops[i];
                 const Stop *end = bus->stops[i + 1];
                 roadLenght += (GetDistanceFromTwoStops(start, end) + GetDistanceFromTwoStops(end, start));
-                geoLenght += ComputeDistance(start->coordinates, end->coordinates) * 2.0;
+                geoLenght += geoDistances[i] * 2.0;
             }
         }
 
@@ -113,10 +124,10 @@ namespace TCatalogue {
     }
 
     int TransportCatalogue::GetUniqueStops(const std::string_view &routetofind) const {
-        std::set<std::string> unique_stops;
+        std::unordered_set<const Stop *> unique_stops;
 
         for (const auto &elem: busname_to_bus_.at(routetofind)->stops) {
-            unique_stops.insert(elem->name);
+            unique_stops.insert(elem);
         }
 
         return static_cast<int>(unique_stops.size());
@@ -167,5 +178,24 @@ namespace TCatalogue {
         return result;
     }
 
+    void TransportCatalogue::BuildNameIndex() {
+        name_index_ = NameIndex(ReturnAllStops(), ReturnAllBus());
+    }
+
+    void TransportCatalogue::SetNameIndex(NameIndex name_index) {
+        name_index_ = std::move(name_index);
+    }
+
+    const NameIndex &TransportCatalogue::GetNameIndex() const {
+        return name_index_;
+    }
+
+    void TransportCatalogue::SetResponseFragments(ResponseFragments fragments) {
+        response_fragments_ = std::move(fragments);
+    }
+
+    const ResponseFragments &TransportCatalogue::GetResponseFragments() const {
+        return response_fragments_;
+    }
 
 }
\ No newline at end of file
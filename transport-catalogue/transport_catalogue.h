@@ -6,22 +6,36 @@
 #include <deque>
 #include "geo.h"
 #include <unordered_map>
+#include <unordered_set>
 #include <set>
 #include "domain.h"
+#include "name_index.h"
+#include "response_fragments.h"
 #include <map>
 
 namespace TCatalogue {
 
+    // Названия остановок и маршрутов, затронутых запросами на изменение базы. В stops попадают
+    // и остановки, расстояние до которых задано заново
+    struct CatalogueChanges {
+        std::unordered_set<std::string> stops;
+        std::unordered_set<std::string> buses;
+    };
+
     class TransportCatalogue {
     public:
 
-        void AddStop(const std::string_view &stop_name, const Geo::Coordinates &coordinates);
+        // Для существующей остановки меняет координаты, сохраняя её адрес
+        const Stop *AddStop(const std::string_view &stop_name, const Geo::Coordinates &coordinates);
 
         const Stop *FindStop(const std::string_view &stop_name) const;
 
-        void AddBus(const std::string_view &bus_name, const std::vector<std::string> &stops, bool is_loop);
+        // Существующий маршрут заменяется на месте, его адрес не меняется
+        void AddBus(const std::string_view &bus_name, std::vector<const Stop *> stops, bool is_loop);
+
+        void RecalculateRouteInfo(const Bus *bus);
 
-        void AddBusFromDb(const std::string_view &bus_name, const std::vector<std::string> &stops, bool is_loop,
+        const Bus *AddBusFromDb(const std::string_view &bus_name, std::vector<const Stop *> stops, bool is_loop,
                           BusRouteInfo busRouteInfo);
 
         const Bus *GetBusInfo(const std::string_view &bus) const;
@@ -42,6 +56,17 @@ namespace TCatalogue {
 
         std::map<std::string_view, const Stop *> ReturnAllStops() const;
 
+        void BuildNameIndex();
+
+        void SetNameIndex(NameIndex name_index);
+
+        const NameIndex &GetNameIndex() const;
+
+        // Фрагменты ссылаются на названия этого справочника
+        void SetResponseFragments(ResponseFragments fragments);
+
+        const ResponseFragments &GetResponseFragments() const;
+
 
         struct StopHasher {
             size_t operator()(const std::pair<const Stop *, const Stop *> &pair) const {
@@ -53,7 +78,7 @@ namespace TCatalogue {
         std::unordered_map<std::pair<const Stop *, const Stop *>, int, StopHasher> stops_pair_to_distance_;
 
     private:
-        std::vector<const Stop *> GetStopsPtrFromString(const std::vector<std::string> &stops);
+        const Bus *PushBus(const std::string_view &bus_name, std::vector<const Stop *> stops, bool is_loop);
 
         std::deque<Stop> stops_;
         std::unordered_map<std::string_view, const Stop *> stopname_to_stop_;
@@ -63,6 +88,9 @@ namespace TCatalogue {
         std::unordered_map<std::string_view, const Bus *> busname_to_bus_;
         std::unordered_map<const Bus *, BusRouteInfo> bus_to_route_info_;
 
+        NameIndex name_index_;
+        ResponseFragments response_fragments_;
+
 
     };
 }
\ No newline at end of file
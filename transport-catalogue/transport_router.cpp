@@ -1,5 +1,8 @@
 #include "transport_router.h"
 
+#include <stdexcept>
+#include <unordered_map>
+
 namespace TRouting {
 
     void TRouter::BuildStopsGraph(const TCatalogue::TransportCatalogue &catalogue,
@@ -32,12 +35,12 @@ namespace TRouting {
 
         stops_graph.AddEdge({bus.name, stop_to_index - stop_from_index, stop_ids_.at(stop_from->name) + 1,
                              stop_ids_.at(stop_to->name),
-                             static_cast<double>(length) / (speed_ * (1000.0 / 60.0))});
+                             RideTime(length, speed_)});
 
         if (!bus.is_loop) {
             stops_graph.AddEdge({bus.name, stop_to_index - stop_from_index, stop_ids_.at(stop_to->name) + 1,
                                  stop_ids_.at(stop_from->name),
-                                 static_cast<double>(lengthInv) / (speed_ * (1000.0 / 60.0))});
+                                 RideTime(lengthInv, speed_)});
         }
     }
 
@@ -66,13 +69,79 @@ namespace TRouting {
         }
 
         graph_ = std::move(stops_graph);
-        router_ = std::make_unique<graph::Router<double>>(graph_);
+        ResetRouter();
+        return graph_;
+    }
+
+    const TRouter::Graph &TRouter::UpdateRoute(const TCatalogue::TransportCatalogue &catalogue,
+                                               const Graph &previous_graph,
+                                               const std::map<std::string, graph::VertexId> &previous_stop_ids,
+                                               const std::unordered_set<std::string> &changed_buses) {
+        // Рёбра одного маршрута в графе идут подряд
+        std::unordered_map<std::string_view, std::pair<graph::EdgeId, graph::EdgeId>> bus_edges;
+        const size_t previous_edge_count = previous_graph.GetEdgeCount();
+        for (graph::EdgeId begin = 0, end; begin < previous_edge_count; begin = end) {
+            const graph::Edge<double> &edge = previous_graph.GetEdge(begin);
+            for (end = begin + 1; end < previous_edge_count && edge.span != 0
+                                  && previous_graph.GetEdge(end).span != 0
+                                  && previous_graph.GetEdge(end).name == edge.name; ++end) {
+            }
+            if (edge.span != 0) {
+                bus_edges.emplace(edge.name, std::make_pair(begin, end));
+            }
+        }
+
+        Graph stops_graph(catalogue.ReturnAllStops().size() * 2);
+        BuildStopsGraph(catalogue, stops_graph);
+
+        std::vector<graph::VertexId> vertex_ids(previous_graph.GetVertexCount());
+        for (const auto &[name, id]: previous_stop_ids) {
+            if (id + 1 >= vertex_ids.size()) {
+                throw std::out_of_range("Stop vertex is out of the previous graph");
+            }
+            vertex_ids[id] = stop_ids_.at(name);
+            vertex_ids[id + 1] = vertex_ids[id] + 1;
+        }
+
+        for (const auto &[bus_name, bus_info]: catalogue.ReturnAllBus()) {
+            const auto range = bus_edges.find(bus_name);
+            if (range == bus_edges.end() || changed_buses.count(bus_info->name)) {
+                AddEdgesForBus(*bus_info, catalogue, stops_graph);
+                continue;
+            }
+            for (graph::EdgeId id = range->second.first; id < range->second.second; ++id) {
+                const graph::Edge<double> &edge = previous_graph.GetEdge(id);
+                stops_graph.AddEdge({bus_info->name, edge.span, vertex_ids.at(edge.from), vertex_ids.at(edge.to),
+                                     edge.weight});
+            }
+        }
+
+        graph_ = std::move(stops_graph);
+        ResetRouter();
         return graph_;
     }
 
     std::optional<graph::Router<double>::RouteInfo>
     TRouter::FindRoute(std::string_view stop_from, std::string_view stop_to) const {
-        return router_->BuildRoute(stop_ids_.at(std::string(stop_from)), stop_ids_.at(std::string(stop_to)));
+        const graph::VertexId from = stop_ids_.at(std::string(stop_from));
+        const graph::VertexId to = stop_ids_.at(std::string(stop_to));
+        return GetRouter().BuildRoute(from, to);
+    }
+
+    const graph::Router<double> &TRouter::GetRouter() const {
+        std::call_once(*router_built_, [this] {
+            router_ = std::make_unique<graph::Router<double>>(graph_);
+        });
+        return *router_;
+    }
+
+    void TRouter::BuildRouter() const {
+        static_cast<void>(GetRouter());
+    }
+
+    void TRouter::ResetRouter() {
+        router_.reset();
+        router_built_ = std::make_unique<std::once_flag>();
     }
 
     const TRouter::Graph &TRouter::GetGraph() const {
@@ -86,6 +155,10 @@ namespace TRouting {
         });
     }
 
+    double TRouter::RideTime(int length, double speed) {
+        return static_cast<double>(length) / (speed * (1000.0 / 60.0));
+    }
+
     const std::map<std::string, graph::VertexId> &TRouter::GetStopIds() const {
         return stop_ids_;
     }
@@ -99,6 +172,6 @@ namespace TRouting {
     TRouter::SetGraph(graph::DirectedWeightedGraph<double> &&graph, std::map<std::string, graph::VertexId> &&stop_ids) {
         graph_ = std::move(graph);
         stop_ids_ = std::move(stop_ids);
-        router_ = std::make_unique<graph::Router<double>>(graph_);
+        ResetRouter();
     }
 }
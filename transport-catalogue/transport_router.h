@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include "transport_catalogue.h"
 #include "router.h"
 #include "json.h"
@@ -28,6 +29,13 @@ namespace TRouting {
 
         const Graph &MakeRoute(const TCatalogue::TransportCatalogue &catalogue);
 
+        // Строит тот же граф, что и MakeRoute, но рёбра маршрутов не из changed_buses берёт
+        // из previous_graph, перенумеровав вершины: после добавления остановок номера сдвигаются.
+        // Маршрут, которого нет в previous_graph, строится заново
+        const Graph &UpdateRoute(const TCatalogue::TransportCatalogue &catalogue, const Graph &previous_graph,
+                                 const std::map<std::string, graph::VertexId> &previous_stop_ids,
+                                 const std::unordered_set<std::string> &changed_buses);
+
         [[nodiscard]] std::optional<graph::Router<double>::RouteInfo>
         FindRoute(std::string_view stop_from, std::string_view stop_to) const;
 
@@ -35,12 +43,25 @@ namespace TRouting {
 
         [[nodiscard]] Json::Node GetBusSettings() const;
 
+        // Время поездки в минутах по длине в метрах и скорости в км/ч
+        [[nodiscard]] static double RideTime(int length, double speed);
+
         const std::map<std::string, graph::VertexId> &GetStopIds() const;
 
+        // Маршрутизатор с предрасчётом всех пар строится при первом FindRoute, а не здесь:
+        // пачкам без запросов Route он не нужен
         void SetGraph(graph::DirectedWeightedGraph<double> &&graph,
                       std::map<std::string, graph::VertexId> &&stop_ids);
 
+        // Строит маршрутизатор заранее, не дожидаясь первого FindRoute
+        void BuildRouter() const;
+
     private:
+        // Строит маршрутизатор один раз, в том числе при одновременных вызовах из нескольких потоков
+        const graph::Router<double> &GetRouter() const;
+
+        void ResetRouter();
+
         void BuildStopsGraph(const TCatalogue::TransportCatalogue &catalogue,
                              Graph &stops_graph);
 
@@ -62,6 +83,8 @@ namespace TRouting {
         double speed_ = 0.0;
         std::map<std::string, graph::VertexId> stop_ids_;
         Graph graph_;
-        std::unique_ptr<graph::Router<double>> router_;
+        mutable std::unique_ptr<graph::Router<double>> router_;
+        // Флаг лежит в куче, чтобы TRouter оставался перемещаемым до SetGraph
+        mutable std::unique_ptr<std::once_flag> router_built_ = std::make_unique<std::once_flag>();
     };
 }